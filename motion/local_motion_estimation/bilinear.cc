@@ -0,0 +1,187 @@
+/**
+ * @file   bilinear.cc
+ * @brief  Fixed point bilinear interpolation
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#include <cstring>
+#include <algorithm>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define BMA_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+#include "bilinear.h"
+#include "motionvector.h"
+
+
+// Weights of each quarter pixel phase, indexed by py*4 + px
+static const BilinearWeights qpel_weights[16] =
+{
+  { 16,  0,  0,  0 }, { 12,  4,  0,  0 }, {  8,  8,  0,  0 }, {  4, 12,  0,  0 },
+  { 12,  0,  4,  0 }, {  9,  3,  3,  1 }, {  6,  6,  2,  2 }, {  3,  9,  1,  3 },
+  {  8,  0,  8,  0 }, {  6,  2,  6,  2 }, {  4,  4,  4,  4 }, {  2,  6,  2,  6 },
+  {  4,  0, 12,  0 }, {  3,  1,  9,  3 }, {  2,  2,  6,  6 }, {  1,  3,  3,  9 }
+};
+
+// Weights of a quarter pixel phase
+const BilinearWeights &bilinear_weights(int px, int py)
+{
+  return(qpel_weights[py*4 + px]);
+}
+
+#ifdef BMA_X86_SIMD
+
+// Blend 8 bytes of each of four rows with 16 bit weights
+static inline __m128i blend8(__m128i a, __m128i b, __m128i c, __m128i d,
+                             __m128i wg, __m128i wi, __m128i wh, __m128i wj)
+{
+  const __m128i zero  = _mm_setzero_si128();
+  const __m128i round = _mm_set1_epi16(8);
+
+  __m128i sum = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), wg),
+                              _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), wi));
+  sum = _mm_add_epi16(sum, _mm_mullo_epi16(_mm_unpacklo_epi8(c, zero), wh));
+  sum = _mm_add_epi16(sum, _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), wj));
+
+  return(_mm_srli_epi16(_mm_add_epi16(sum, round), 4));
+}
+
+#endif
+
+// Bilinear blend of a row of interleaved pixels
+void bilinear_row(const unsigned char *r0, const unsigned char *r1, int cn,
+                  int bytes, const BilinearWeights &w, unsigned char *out)
+{
+  int x = 0;
+
+#ifdef BMA_X86_SIMD
+  const __m128i vg = _mm_set1_epi16(w.g);
+  const __m128i vi = _mm_set1_epi16(w.i);
+  const __m128i vh = _mm_set1_epi16(w.h);
+  const __m128i vj = _mm_set1_epi16(w.j);
+
+  for(; x + 16 <= bytes; x += 16)
+  {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(r0 + x));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(r0 + x + cn));
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(r1 + x));
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(r1 + x + cn));
+
+    __m128i lo = blend8(a, b, c, d, vg, vi, vh, vj);
+    __m128i hi = blend8(_mm_srli_si128(a, 8), _mm_srli_si128(b, 8),
+                        _mm_srli_si128(c, 8), _mm_srli_si128(d, 8),
+                        vg, vi, vh, vj);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x),
+                     _mm_packus_epi16(lo, hi));
+  }
+
+  for(; x + 8 <= bytes; x += 8)
+  {
+    __m128i a = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(r0 + x));
+    __m128i b = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(r0 + x + cn));
+    __m128i c = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(r1 + x));
+    __m128i d = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(r1 + x + cn));
+
+    __m128i v = blend8(a, b, c, d, vg, vi, vh, vj);
+
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out + x),
+                     _mm_packus_epi16(v, v));
+  }
+#endif
+
+  for(; x < bytes; x++)
+  {
+    out[x] = (unsigned char)((w.g*r0[x] + w.i*r0[x+cn] +
+                              w.h*r1[x] + w.j*r1[x+cn] + 8) >> 4);
+  }
+}
+
+// Interpolate pixel at fixed point co-ordinates
+unsigned char interpolate_fixed(const cv::Mat &img, int fx, int fy)
+{
+  // Shifts round towards minus infinity, so the fractions are never
+  // negative
+
+  int ix = fx >> BILINEAR_FRAC_BITS;
+  int iy = fy >> BILINEAR_FRAC_BITS;
+  int a  = fx & (BILINEAR_ONE-1);
+  int b  = fy & (BILINEAR_ONE-1);
+
+  int wide = img.cols;
+  int high = img.rows;
+
+  const unsigned char *r0 = ((iy >= 0) && (iy < high)) ?
+                            img.ptr<unsigned char>(iy) : nullptr;
+  const unsigned char *r1 = ((iy+1 >= 0) && (iy+1 < high)) ?
+                            img.ptr<unsigned char>(iy+1) : nullptr;
+
+  auto pixel = [&](const unsigned char *row, int x) -> int
+  {
+    return((row && (x >= 0) && (x < wide)) ? row[x] : 0);
+  };
+
+  int g = pixel(r0, ix), i = pixel(r0, ix+1);
+  int h = pixel(r1, ix), j = pixel(r1, ix+1);
+
+  int sum = (BILINEAR_ONE-a)*((BILINEAR_ONE-b)*g + b*h) +
+            a*((BILINEAR_ONE-b)*i + b*j);
+
+  return((unsigned char)((sum + (1 << (2*BILINEAR_FRAC_BITS-1))) >>
+                         (2*BILINEAR_FRAC_BITS)));
+}
+
+// Copy count pixels of an image row from x into line, with zero for pixels
+// off the image
+static void fetch_line(const cv::Mat &img, int y, int x, int count,
+                       unsigned char *line)
+{
+  std::memset(line, 0, count);
+  if((y < 0) || (y >= img.rows)) return;
+
+  int x0 = std::max(x, 0);
+  int x1 = std::min(x + count, img.cols);
+
+  if(x0 < x1)
+    std::memcpy(line + (x0 - x), img.ptr<unsigned char>(y) + x0, x1 - x0);
+}
+
+// Interpolate block at quarter pixel co-ordinates
+void interpolate_block(const cv::Mat &img, int qx, int qy, int wide, int high,
+                       unsigned char *out, size_t stride)
+{
+  int sx = qx >> MV_FRAC_BITS;
+  int sy = qy >> MV_FRAC_BITS;
+  const BilinearWeights &w = bilinear_weights(qx & (MV_UNIT-1),
+                                              qy & (MV_UNIT-1));
+
+  // Blocks whose neighbours are all on the image are read in place
+
+  if((sx >= 0) && (sy >= 0) && (sx + wide < img.cols) &&
+     (sy + high < img.rows))
+  {
+    for(int y = 0; y < high; y++)
+    {
+      const unsigned char *r0 = img.ptr<unsigned char>(sy + y) + sx;
+      bilinear_row(r0, r0 + img.step, 1, wide, w, out + y*stride);
+    }
+    return;
+  }
+
+  unsigned char line[2][BILINEAR_STRIP + 1];
+
+  for(int x = 0; x < wide; x += BILINEAR_STRIP)
+  {
+    int count = std::min(wide - x, BILINEAR_STRIP);
+
+    for(int y = 0; y < high; y++)
+    {
+      fetch_line(img, sy + y, sx + x, count + 1, line[0]);
+      fetch_line(img, sy + y + 1, sx + x, count + 1, line[1]);
+      bilinear_row(line[0], line[1], 1, count, w, out + y*stride + x);
+    }
+  }
+}
@@ -0,0 +1,87 @@
+/**
+ * @file   bilinear.h
+ * @brief  Fixed point bilinear interpolation
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#ifndef bilinear_h
+#define bilinear_h
+
+#include <cstddef>
+#include <opencv2/core.hpp>
+
+/// Fraction bits of the fixed point co-ordinates of interpolate_fixed()
+#define BILINEAR_FRAC_BITS 8
+
+/// One pixel in fixed point co-ordinates
+#define BILINEAR_ONE (1 << BILINEAR_FRAC_BITS)
+
+/// Widest block that interpolate_block() interpolates in one pass; wider
+/// blocks are done in strips
+#define BILINEAR_STRIP 64
+
+
+/// Bilinear weights of the four neighbours of a quarter pixel phase, in
+/// sixteenths
+struct BilinearWeights
+{
+  int g;    ///< top left
+  int i;    ///< top right
+  int h;    ///< bottom left
+  int j;    ///< bottom right
+};
+
+/**
+ * Weights of a quarter pixel phase from a precomputed table
+ * @param px        quarter pixel phase of x co-ordinate, 0 to 3
+ * @param py        quarter pixel phase of y co-ordinate, 0 to 3
+ * @return weights
+ */
+const BilinearWeights &bilinear_weights(int px, int py);
+
+/**
+ * Bilinear blend of a row of interleaved pixels with SSE2 where available.
+ * Each output byte blends the byte, the byte one pixel (cn bytes) to its
+ * right and the two below them with weights in sixteenths, rounding halves
+ * up, which is exact for quarter pixel phases. The source rows must have
+ * one readable pixel beyond bytes.
+ * @param r0        top source row
+ * @param r1        bottom source row
+ * @param cn        bytes per pixel
+ * @param bytes     bytes to output
+ * @param w         weights
+ * @param out       output row
+ */
+void bilinear_row(const unsigned char *r0, const unsigned char *r1, int cn,
+                  int bytes, const BilinearWeights &w, unsigned char *out);
+
+/**
+ * Interpolate a pixel at fixed point co-ordinates; pixels off the image
+ * are zero. Weights are products of the fraction of each co-ordinate in
+ * 1/BILINEAR_ONE and the sum is rounded half up, so for quarter pixel
+ * co-ordinates the result is the same as bilinear_row().
+ * @param img       input image; must be single channel uchar
+ * @param fx        x co-ordinate in 1/BILINEAR_ONE pixels
+ * @param fy        y co-ordinate in 1/BILINEAR_ONE pixels
+ * @return interpolated pixel value
+ */
+unsigned char interpolate_fixed(const cv::Mat &img, int fx, int fy);
+
+/**
+ * Interpolate a block at quarter pixel co-ordinates a row at a time with
+ * bilinear_row(); pixels off the image are zero, as for interpolate().
+ * Rows that need pixels off the image are copied into a zero padded line
+ * first.
+ * @param img       input image; must be single channel uchar
+ * @param qx        x co-ordinate of block origin in quarter pixels
+ * @param qy        y co-ordinate of block origin in quarter pixels
+ * @param wide      width of block
+ * @param high      height of block
+ * @param out       top left pixel of output block
+ * @param stride    row stride of output in bytes
+ */
+void interpolate_block(const cv::Mat &img, int qx, int qy, int wide, int high,
+                       unsigned char *out, size_t stride);
+
+#endif    // bilinear_h
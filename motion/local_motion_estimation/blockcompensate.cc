@@ -5,27 +5,200 @@
  * @date   2025.10.01
  */
 
+#include <cmath>
+#include <cstring>
+#include <algorithm>
 #include <iostream>
 
+#include <opencv2/imgproc.hpp>
+
 #include "blockcompensate.h"
 #include "bmsupport.h"
+#include "bilinear.h"
+#include "staticblocks.h"
 
 
 // Apply motion to image
 void block_compensate(const cv::Mat &previous_image,
-                      const std::vector<cv::Vec2f> &mv,
+                      const MotionField &mv,
+                      int blk_size,
+                      cv::Mat &output_image,
+                      ThreadPool *pool,
+                      const SkipMap *skip)
+{
+  const int cn   = previous_image.channels();
+  const int cols = previous_image.cols;
+  const int rows = previous_image.rows;
+  const int pad  = INTERP_PADDING;
+
+  if((previous_image.depth() != CV_8U) || (cn > 4))
+  {
+    std::cerr << "Error: image must have 1 to 4 channels of uchar\n";
+    return;
+  }
+
+  int blocks_wide = cols/blk_size;
+  int blocks_high = rows/blk_size;
+
+  if((mv.size() != blocks_wide*blocks_high) ||
+     (skip && (skip->size() != mv.size())))
+  {
+    std::cerr << "Error: wrong motion field size\n";
+    return;
+  }
+
+  // Zero border as for InterpolatedReference, with one extra row and column
+  // so that the right and bottom neighbours can be read without checks;
+  // only needed for blocks that are not static
+
+  bool moving = !skip ||
+                (std::count(skip->begin(), skip->end(), 0) > 0);
+
+  cv::Mat padded;
+  if(moving)
+    cv::copyMakeBorder(previous_image, padded, pad, pad+1, pad, pad+1,
+                       cv::BORDER_CONSTANT, 0);
+
+  // Blocks beyond the border are interpolated from each channel; only split
+  // the image if there are any
+
+  auto contained = [&](int sx, int sy)
+  {
+    return((sx >= -pad) && (sy >= -pad) &&
+           (sx + blk_size <= cols + pad) && (sy + blk_size <= rows + pad));
+  };
+
+  std::vector<cv::Mat> channels;
+
+  for(int b = 0; b < (int)(mv.size()); b++)
+  {
+    if(is_static(skip, b)) continue;
+
+    int sx = (b % blocks_wide)*blk_size + (mv[b][0] >> MV_FRAC_BITS);
+    int sy = (b / blocks_wide)*blk_size + (mv[b][1] >> MV_FRAC_BITS);
+
+    if(!contained(sx, sy))
+    {
+      if(cn == 1)
+        channels.assign(1, previous_image);
+      else
+        cv::split(previous_image, channels);
+      break;
+    }
+  }
+
+  // Set up output image; previous_image may be the same Mat, so keep its
+  // data for static blocks
+
+  cv::Mat source = previous_image;
+  output_image = cv::Mat(rows, cols, previous_image.type());
+
+  const int row_bytes = blk_size*cn;
+
+  auto process_row = [&](int by)
+  {
+    // A row of one channel of a block beyond the border
+    std::vector<unsigned char> line(channels.empty() ? 0 : blk_size);
+
+    for(int bx = 0; bx < blocks_wide; bx++)
+    {
+      MotionVector vec = mv[by*blocks_wide + bx];
+      int ox = bx*blk_size;
+      int oy = by*blk_size;
+
+      int qx = ox*MV_UNIT + vec[0];
+      int qy = oy*MV_UNIT + vec[1];
+      int sx = qx >> MV_FRAC_BITS;
+      int sy = qy >> MV_FRAC_BITS;
+      int px = qx & (MV_UNIT-1);
+      int py = qy & (MV_UNIT-1);
+
+      unsigned char *dst = output_image.ptr<unsigned char>(oy) + ox*cn;
+
+      if(is_static(skip, by*blocks_wide + bx))
+      {
+        const unsigned char *src = source.ptr<unsigned char>(oy) + ox*cn;
+
+        for(int j = 0; j < blk_size; j++)
+        {
+          std::memcpy(dst, src, row_bytes);
+          src += source.step;
+          dst += output_image.step;
+        }
+        continue;
+      }
+
+      if(contained(sx, sy))
+      {
+        const unsigned char *src = padded.ptr<unsigned char>(sy + pad) +
+                                   (sx + pad)*cn;
+
+        if((px == 0) && (py == 0))
+        {
+          // Whole pixel vector
+          for(int j = 0; j < blk_size; j++)
+          {
+            std::memcpy(dst, src, row_bytes);
+            src += padded.step;
+            dst += output_image.step;
+          }
+        }
+        else
+        {
+          const BilinearWeights &w = bilinear_weights(px, py);
+
+          for(int j = 0; j < blk_size; j++)
+          {
+            bilinear_row(src, src + padded.step, cn, row_bytes, w, dst);
+            src += padded.step;
+            dst += output_image.step;
+          }
+        }
+        continue;
+      }
+
+      // Each channel is interpolated a row at a time and interleaved
+
+      for(int j = 0; j < blk_size; j++)
+      {
+        unsigned char *out = output_image.ptr<unsigned char>(oy+j) + ox*cn;
+
+        for(int ch = 0; ch < cn; ch++)
+        {
+          interpolate_block(channels[ch], qx, qy + j*MV_UNIT, blk_size, 1,
+                            line.data(), 0);
+
+          for(int i = 0; i < blk_size; i++)
+            out[i*cn + ch] = line[i];
+        }
+      }
+    }
+  };
+
+  if(pool)
+    pool->parallel_for(blocks_high, process_row);
+  else
+  {
+    for(int by = 0; by < blocks_high; by++) process_row(by);
+  }
+}
+
+// Apply motion to image with interpolated previous image
+void block_compensate(const InterpolatedReference &previous_image,
+                      const MotionField &mv,
                       int blk_size,
                       cv::Mat &output_image)
 {
+  const cv::Mat &image = previous_image.image();
+
   // Set up output image
-  output_image = cv::Mat(previous_image.rows, previous_image.cols,
-                         previous_image.type());
+  output_image = cv::Mat(image.rows, image.cols, image.type());
 
 
   // Calculate dimensions of motion field
 
-  int blocks_wide = previous_image.cols/blk_size;
-  int blocks_high = previous_image.rows/blk_size;
+  int blocks_wide = image.cols/blk_size;
+  int blocks_high = image.rows/blk_size;
 
   if(mv.size() != blocks_wide*blocks_high)
   {
@@ -35,26 +208,37 @@ void block_compensate(const cv::Mat &previous_image,
 
   // Compensate blocks
 
-  int x, y;
-  int boff;
-
   for(int by = 0; by < blocks_high; by++)
   {
     for(int bx = 0; bx < blocks_wide; bx++)
     {
-      for(int j = 0; j < blk_size; j++)
-      {
-        y = by*blk_size+j;
+      MotionVector vec = mv[by*blocks_wide + bx];
+      int ox = bx*blk_size;
+      int oy = by*blk_size;
 
-        for(int i = 0; i < blk_size; i++)
-        {
-          x = bx*blk_size+i;
-          boff = by*blocks_wide;
+      // Blocks are copied from the phase planes if they lie within them
 
-          output_image.at<unsigned char>(y, x) =
-                interpolate(previous_image, x+mv[boff+bx][0], y+mv[boff+bx][1]);
+      int qx = ox*MV_UNIT + vec[0];
+      int qy = oy*MV_UNIT + vec[1];
+      int sx = qx >> MV_FRAC_BITS;
+      int sy = qy >> MV_FRAC_BITS;
+
+      if(previous_image.contains(sx, sy, blk_size, blk_size))
+      {
+        const unsigned char *src = previous_image.pixel(sx, sy,
+                                                        qx & (MV_UNIT-1),
+                                                        qy & (MV_UNIT-1));
+        for(int j = 0; j < blk_size; j++)
+        {
+          std::memcpy(output_image.ptr<unsigned char>(oy+j) + ox, src, blk_size);
+          src += previous_image.stride();
         }
+        continue;
       }
+
+      interpolate_block(image, qx, qy, blk_size, blk_size,
+                        output_image.ptr<unsigned char>(oy) + ox,
+                        output_image.step);
     }
   }
 }
@@ -11,16 +11,45 @@
 #include <vector>
 #include <opencv2/core.hpp>
 
+#include "interpolatedref.h"
+#include "motionvector.h"
+#include "threadpool.h"
+
 
 /**
- * Apply motion to image
- * @param previous_image    previous image
+ * Apply motion to image in one pass over the blocks, whatever the number
+ * of channels. Blocks with whole pixel vectors are copied row by row and
+ * the others are bilinear blends of the zero bordered image, giving the
+ * same result as compensating each channel separately with the version
+ * below. Blocks further off the image than INTERP_PADDING are interpolated
+ * as before.
+ * @param previous_image    previous image; 1 to 4 channels of uchar,
+ *                          interleaved
  * @param mv                motion vector field
  * @param blk_size          block size
  * @param output_image      block motion compensated image output
+ * @param pool              if not null, block rows are spread across it
+ * @param skip              if not null, static blocks, which are copied
+ *                          straight from previous_image; if every block is
+ *                          static the padded copy is not made at all
  */
 void block_compensate(const cv::Mat &previous_image,
-                      const std::vector<cv::Vec2f> &mv,
+                      const MotionField &mv,
+                      int blk_size,
+                      cv::Mat &output_image,
+                      ThreadPool *pool = nullptr,
+                      const SkipMap *skip = nullptr);
+
+/**
+ * Apply motion to image using precomputed phase planes; blocks with quarter
+ * pixel vectors are copied from the planes, any others are interpolated
+ * @param previous_image    interpolated previous image
+ * @param mv                motion vector field
+ * @param blk_size          block size
+ * @param output_image      block motion compensated image output
+ */
+void block_compensate(const InterpolatedReference &previous_image,
+                      const MotionField &mv,
                       int blk_size,
                       cv::Mat &output_image);
 
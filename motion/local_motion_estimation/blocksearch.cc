@@ -0,0 +1,201 @@
+/**
+ * @file   blocksearch.cc
+ * @brief  Candidate checking and search patterns shared by the predictive
+ *         block matching algorithms
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#include <algorithm>
+
+#include "blocksearch.h"
+#include "bmsupport.h"
+
+
+// Median of three
+static inline int median3(int a, int b, int c)
+{
+  return(std::max(std::min(a, b), std::min(std::max(a, b), c)));
+}
+
+// Start search of a block
+BlockSearch::BlockSearch(const cv::Mat &current, const cv::Mat &previous,
+                         int ox, int oy, int blk_size, int range)
+  : current_(current), previous_(previous), ox_(ox), oy_(oy), size_(blk_size),
+    best_x_(0), best_y_(0), best_sad_(INT_MAX), sads_(0), steps_(0)
+{
+  xmin_ = std::max(-range, -ox);
+  xmax_ = std::min(range, previous.cols - blk_size - ox);
+  ymin_ = std::max(-range, -oy);
+  ymax_ = std::min(range, previous.rows - blk_size - oy);
+}
+
+// Check a candidate
+bool BlockSearch::check(int dx, int dy)
+{
+  if((dx < xmin_) || (dx > xmax_) || (dy < ymin_) || (dy > ymax_))
+    return(false);
+
+  int sad = SAD_integer_bounded(current_, previous_, ox_, oy_,
+                                ox_+dx, oy_+dy, size_, best_sad_);
+  sads_++;
+  if(sad >= best_sad_) return(false);
+
+  best_x_   = dx;
+  best_y_   = dy;
+  best_sad_ = sad;
+
+  return(true);
+}
+
+// Left, top and top right vectors
+int spatial_predictors(const MotionField &mv, int bx, int by, int blocks_wide,
+                       MotionVector *predictors)
+{
+  int count = 0;
+
+  if(bx > 0) predictors[count++] = mv[by*blocks_wide + (bx-1)];
+  if(by > 0) {
+    predictors[count++] = mv[(by-1)*blocks_wide + bx];
+    if(bx < blocks_wide-1)
+      predictors[count++] = mv[(by-1)*blocks_wide + (bx+1)];
+  }
+
+  return(count);
+}
+
+// Median of spatial predictors
+MotionVector median_predictor(const MotionVector *predictors, int count)
+{
+  switch(count)
+  {
+    case 0:
+    return(MotionVector(0, 0));
+
+    case 1:
+    return(mv_pixels(predictors[0][0]/MV_UNIT, predictors[0][1]/MV_UNIT));
+
+    case 2:
+    return(mv_pixels(((predictors[0][0] + predictors[1][0])/MV_UNIT)/2,
+                     ((predictors[0][1] + predictors[1][1])/MV_UNIT)/2));
+  }
+
+  return(mv_pixels(median3(predictors[0][0], predictors[1][0],
+                           predictors[2][0])/MV_UNIT,
+                   median3(predictors[0][1], predictors[1][1],
+                           predictors[2][1])/MV_UNIT));
+}
+
+// Median of spatial predictors of a block
+MotionVector median_predictor(const MotionField &mv, int bx, int by,
+                              int blocks_wide)
+{
+  MotionVector predictors[3];
+  int count = spatial_predictors(mv, bx, by, blocks_wide, predictors);
+
+  return(median_predictor(predictors, count));
+}
+
+// Least SAD of spatial neighbours
+int neighbour_sad(const std::vector<int> &sad, int bx, int by,
+                  int blocks_wide)
+{
+  int least = INT_MAX;
+
+  if(bx > 0) least = sad[by*blocks_wide + (bx-1)];
+  if(by > 0) {
+    least = std::min(least, sad[(by-1)*blocks_wide + bx]);
+    if(bx < blocks_wide-1)
+      least = std::min(least, sad[(by-1)*blocks_wide + (bx+1)]);
+  }
+
+  return(least);
+}
+
+// Zero vector for a static block
+void static_block(const cv::Mat &current, const cv::Mat &previous, int bx,
+                  int by, int blk_size, int blocks_wide,
+                  std::vector<int> &sad, MotionField &mv, BlockStats *stats)
+{
+  int index = by*blocks_wide + bx;
+  int ox = bx*blk_size;
+  int oy = by*blk_size;
+
+  mv[index]  = MotionVector(0, 0);
+  sad[index] = SAD_integer(current, previous, ox, oy, ox, oy, blk_size);
+
+  if(stats)
+  {
+    *stats = BlockStats{};
+    stats->exit = EXIT_STATIC;
+  }
+}
+
+// Copy search counters to block statistics
+void set_block_stats(const BlockSearch &search, BlockExit exit,
+                     BlockPattern pattern, BlockStats &stats)
+{
+  stats.sads    = search.sads();
+  stats.steps   = search.steps();
+  stats.exit    = exit;
+  stats.pattern = pattern;
+}
+
+// Large hexagon search
+void hexagon_refine(BlockSearch &search)
+{
+  // Points in order around the hexagon, so that after moving to point i
+  // the points i-1, i and i+1 around the new centre are the new ones
+
+  static const int hexagon[6][2] = { {-2, 0}, {-1, -2}, { 1, -2},
+                                     { 2, 0}, { 1,  2}, {-1,  2} };
+
+  int cx = search.best_x();
+  int cy = search.best_y();
+  int moved = -1;
+
+  search.step();
+  for(int i = 0; i < 6; i++)
+    if(search.check(cx + hexagon[i][0], cy + hexagon[i][1])) moved = i;
+
+  while(moved >= 0)
+  {
+    int last = moved;
+    cx = search.best_x();
+    cy = search.best_y();
+    moved = -1;
+
+    search.step();
+    for(int k = 5; k <= 7; k++)
+    {
+      int i = (last + k) % 6;
+      if(search.check(cx + hexagon[i][0], cy + hexagon[i][1])) moved = i;
+    }
+  }
+}
+
+// Small diamond search
+void diamond_refine(BlockSearch &search)
+{
+  // Up, right, down, left; the opposite of point i is the previous centre
+
+  static const int diamond[4][2] = { {0, -1}, {1, 0}, {0, 1}, {-1, 0} };
+
+  int moved = -1;
+
+  do
+  {
+    int from = (moved >= 0) ? (moved + 2) % 4 : -1;
+    int cx = search.best_x();
+    int cy = search.best_y();
+    moved = -1;
+
+    search.step();
+    for(int i = 0; i < 4; i++)
+    {
+      if(i == from) continue;
+      if(search.check(cx + diamond[i][0], cy + diamond[i][1])) moved = i;
+    }
+  }
+  while(moved >= 0);
+}
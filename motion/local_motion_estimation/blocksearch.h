@@ -0,0 +1,186 @@
+/**
+ * @file   blocksearch.h
+ * @brief  Candidate checking and search patterns shared by the predictive
+ *         block matching algorithms
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#ifndef blocksearch_h
+#define blocksearch_h
+
+#include <vector>
+#include <climits>
+
+#include <opencv2/core.hpp>
+
+#include "wavefront.h"
+#include "blockstats.h"
+#include "motionvector.h"
+
+
+/// Buffers of a predictive search kept from frame to frame so that they are
+/// only allocated when the image size changes
+struct PredictiveWorkspace
+{
+  WavefrontProgress wavefront;
+  std::vector<int>  sad;         ///< SAD of the vector chosen for each block
+};
+
+
+/**
+ * BlockSearch
+ * @brief Best candidate so far in the search of one block. Candidates are
+ *        whole pixel displacements within +/-range of the block and inside
+ *        the previous image; others are ignored. SADs are bounded by the
+ *        best so far, so only a strictly lower SAD replaces the best and
+ *        the best SAD is always exact.
+ */
+class BlockSearch
+{
+public:
+  /**
+   * Start search of a block; no candidate has been checked
+   * @param current    current image
+   * @param previous   previous image
+   * @param ox         x co-ordinate of block origin in current image
+   * @param oy         y co-ordinate of block origin in current image
+   * @param blk_size   block size
+   * @param range      greatest displacement in pixels
+   */
+  BlockSearch(const cv::Mat &current, const cv::Mat &previous,
+              int ox, int oy, int blk_size, int range);
+
+  /**
+   * Check a candidate
+   * @param dx         displacement in pixels
+   * @param dy         displacement in pixels
+   * @return true if it is the new best
+   */
+  bool check(int dx, int dy);
+
+  /**
+   * Check a whole pixel motion vector
+   * @param v          motion vector
+   * @return true if it is the new best
+   */
+  bool check(const MotionVector &v)
+  {
+    return(check(v[0]/MV_UNIT, v[1]/MV_UNIT));
+  }
+
+  /// Best displacement in pixels
+  int best_x() const        { return(best_x_); }
+  int best_y() const        { return(best_y_); }
+
+  /// SAD of best candidate, INT_MAX if none has been checked
+  int best_sad() const      { return(best_sad_); }
+
+  /// Best displacement as a motion vector
+  MotionVector best() const { return(mv_pixels(best_x_, best_y_)); }
+
+  /// Count a position of a search pattern
+  void step()               { steps_++; }
+
+  /// Number of SADs calculated and of pattern positions
+  int sads() const          { return(sads_); }
+  int steps() const         { return(steps_); }
+
+private:
+  const cv::Mat &current_, &previous_;
+  int ox_, oy_, size_;
+  int xmin_, xmax_, ymin_, ymax_;   // bounds of displacement
+  int best_x_, best_y_, best_sad_;
+  int sads_, steps_;
+};
+
+
+/**
+ * Spatial predictors of a block: the vectors of the left, top and top
+ * right blocks, those that exist, in that order
+ * @param mv           motion vectors estimated so far
+ * @param bx           block column
+ * @param by           block row
+ * @param blocks_wide  blocks per row
+ * @param predictors   set to up to 3 vectors
+ * @return number of predictors
+ */
+int spatial_predictors(const MotionField &mv, int bx, int by, int blocks_wide,
+                       MotionVector *predictors);
+
+/**
+ * Median predictor in whole pixels, as used by PMVFAST: zero with no
+ * spatial predictors, the one there is, the mean of two rounded towards
+ * zero, or the median of three, each component on its own
+ * @param predictors   spatial predictors, see spatial_predictors()
+ * @param count        number of predictors
+ * @return median predictor
+ */
+MotionVector median_predictor(const MotionVector *predictors, int count);
+
+/**
+ * As above for the spatial predictors of a block
+ * @param mv           motion vectors estimated so far
+ * @param bx           block column
+ * @param by           block row
+ * @param blocks_wide  blocks per row
+ * @return median predictor
+ */
+MotionVector median_predictor(const MotionField &mv, int bx, int by,
+                              int blocks_wide);
+
+/**
+ * Least SAD of the left, top and top right blocks, the prediction of the
+ * SAD of this block used for early termination
+ * @param sad          SAD of each block estimated so far
+ * @param bx           block column
+ * @param by           block row
+ * @param blocks_wide  blocks per row
+ * @return least neighbouring SAD, INT_MAX if there are no neighbours
+ */
+int neighbour_sad(const std::vector<int> &sad, int bx, int by,
+                  int blocks_wide);
+
+/**
+ * Give a static block a zero vector without a search. Its zero vector SAD
+ * is kept as the prediction of its neighbours, as if it had been searched.
+ * @param current      current image
+ * @param previous     previous image
+ * @param bx           block column
+ * @param by           block row
+ * @param blk_size     block size
+ * @param blocks_wide  blocks per row
+ * @param sad          SAD of each block, set for this one
+ * @param mv           motion vectors, set for this one
+ * @param stats        if not null, statistics of block, reset to EXIT_STATIC
+ */
+void static_block(const cv::Mat &current, const cv::Mat &previous, int bx,
+                  int by, int blk_size, int blocks_wide,
+                  std::vector<int> &sad, MotionField &mv, BlockStats *stats);
+
+/**
+ * Copy the counters of a search to the statistics of a block
+ * @param search       search of block
+ * @param exit         how the search finished
+ * @param pattern      largest pattern used
+ * @param stats        statistics of block
+ */
+void set_block_stats(const BlockSearch &search, BlockExit exit,
+                     BlockPattern pattern, BlockStats &stats);
+
+/**
+ * Large hexagon search: check the 6 points of a hexagon of radius 2 around
+ * the best candidate and move to the best of them until the centre is best.
+ * After a move only the 3 points that are new are checked.
+ * @param search       search of block
+ */
+void hexagon_refine(BlockSearch &search);
+
+/**
+ * Small diamond search: check the 4 neighbours of the best candidate and
+ * move to the best of them until the centre is best
+ * @param search       search of block
+ */
+void diamond_refine(BlockSearch &search);
+
+#endif    // blocksearch_h
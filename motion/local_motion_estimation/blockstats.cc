@@ -0,0 +1,151 @@
+/**
+ * @file   blockstats.cc
+ * @brief  Per block search counters and their export as JSON or CSV
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#include "blockstats.h"
+
+
+// Add up block counters
+void add_block_stats(const BlockStatsField &blocks, FrameStats &frame)
+{
+  for(const BlockStats &b : blocks)
+  {
+    frame.blocks++;
+    frame.sads            += b.sads;
+    frame.steps           += b.steps;
+    frame.subpixel        += b.subpixel;
+    frame.median_stops    += (b.exit == EXIT_MEDIAN);
+    frame.temporal_stops  += (b.exit == EXIT_TEMPORAL);
+    frame.predictor_stops += (b.exit == EXIT_PREDICTOR);
+    frame.static_blocks   += (b.exit == EXIT_STATIC);
+    frame.small_patterns  += (b.pattern == PATTERN_SMALL);
+    frame.large_patterns  += (b.pattern == PATTERN_LARGE);
+  }
+}
+
+// Name of exit
+const char *exit_name(BlockExit exit)
+{
+  switch(exit)
+  {
+    case EXIT_MEDIAN:    return("median");
+    case EXIT_TEMPORAL:  return("temporal");
+    case EXIT_PREDICTOR: return("predictor");
+    case EXIT_STATIC:    return("static");
+    default:             break;
+  }
+
+  return("search");
+}
+
+// Name of pattern
+const char *pattern_name(BlockPattern pattern)
+{
+  switch(pattern)
+  {
+    case PATTERN_SMALL: return("small");
+    case PATTERN_LARGE: return("large");
+    default:            break;
+  }
+
+  return("none");
+}
+
+StatsWriter::StatsWriter() : file_(nullptr), json_(false), frames_(0)
+{
+}
+
+StatsWriter::~StatsWriter()
+{
+  close();
+}
+
+// Create file
+bool StatsWriter::open(const std::string &filename)
+{
+  close();
+
+  file_ = fopen(filename.c_str(), "w");
+  if(!file_) return(false);
+
+  json_   = (filename.size() >= 5) &&
+            (filename.compare(filename.size()-5, 5, ".json") == 0);
+  frames_ = 0;
+
+  if(json_)
+    fprintf(file_, "{\n  \"block_fields\": [\"bx\", \"by\", \"sads\", "
+                   "\"steps\", \"subpixel\", \"exit\", \"pattern\"],\n"
+                   "  \"frames\": [");
+  else
+    fprintf(file_, "frame,estimate_us,subpixel_us,bx,by,sads,steps,"
+                   "subpixel,exit,pattern\n");
+
+  return(!ferror(file_));
+}
+
+// Append a frame
+bool StatsWriter::write(const FrameStats &frame, const BlockStatsField &blocks,
+                        int blocks_wide)
+{
+  if(!file_) return(false);
+
+  if(!json_)
+  {
+    for(size_t i = 0; i < blocks.size(); i++)
+    {
+      const BlockStats &b = blocks[i];
+      fprintf(file_, "%d,%lld,%lld,%d,%d,%d,%d,%d,%s,%s\n", frame.frame,
+              frame.estimate_us, frame.subpixel_us,
+              (int)(i % blocks_wide), (int)(i / blocks_wide),
+              b.sads, b.steps, b.subpixel, exit_name(b.exit),
+              pattern_name(b.pattern));
+    }
+
+    frames_++;
+    return(!ferror(file_));
+  }
+
+  fprintf(file_, "%s\n    {\"frame\": %d, \"estimate_us\": %lld, "
+                 "\"subpixel_us\": %lld, \"blocks\": %lld, \"sads\": %lld, "
+                 "\"steps\": %lld, \"subpixel\": %lld,\n"
+                 "     \"median_stops\": %lld, \"temporal_stops\": %lld, "
+                 "\"predictor_stops\": %lld, \"static_blocks\": %lld, "
+                 "\"small_patterns\": %lld,\n     \"large_patterns\": %lld, "
+                 "\"block_stats\": [",
+          frames_ ? "," : "", frame.frame, frame.estimate_us,
+          frame.subpixel_us, frame.blocks, frame.sads, frame.steps,
+          frame.subpixel, frame.median_stops, frame.temporal_stops,
+          frame.predictor_stops, frame.static_blocks, frame.small_patterns,
+          frame.large_patterns);
+
+  for(size_t i = 0; i < blocks.size(); i++)
+  {
+    const BlockStats &b = blocks[i];
+    fprintf(file_, "%s\n      [%d, %d, %d, %d, %d, \"%s\", \"%s\"]",
+            i ? "," : "", (int)(i % blocks_wide), (int)(i / blocks_wide),
+            b.sads, b.steps, b.subpixel, exit_name(b.exit),
+            pattern_name(b.pattern));
+  }
+
+  fprintf(file_, "]}");
+
+  frames_++;
+  return(!ferror(file_));
+}
+
+// Finish and close
+bool StatsWriter::close()
+{
+  if(!file_) return(false);
+
+  if(json_) fprintf(file_, "\n  ]\n}\n");
+
+  bool ok = !ferror(file_);
+  ok = (fclose(file_) == 0) && ok;
+  file_ = nullptr;
+
+  return(ok);
+}
@@ -0,0 +1,134 @@
+/**
+ * @file   blockstats.h
+ * @brief  Per block search counters and their export as JSON or CSV
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#ifndef blockstats_h
+#define blockstats_h
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+/// How the search of a block finished
+enum BlockExit : unsigned char
+{
+  EXIT_SEARCH,       ///< after a pattern search
+  EXIT_MEDIAN,       ///< median predictor was below threshold
+  EXIT_TEMPORAL,     ///< co-located vector was below threshold
+  EXIT_PREDICTOR,    ///< best predictor was below threshold
+  EXIT_STATIC        ///< static block, not searched
+};
+
+/// Largest search pattern used for a block
+enum BlockPattern : unsigned char
+{
+  PATTERN_NONE,      ///< no pattern search
+  PATTERN_SMALL,     ///< small diamond only
+  PATTERN_LARGE      ///< large diamond or hexagon, then small
+};
+
+/// Counters of the search of one block; an algorithm only fills those that
+/// apply to it
+struct BlockStats
+{
+  int          sads      = 0;             ///< integer SADs calculated
+  int          steps     = 0;             ///< pattern positions searched
+  int          subpixel  = 0;             ///< quarter pixel SADs calculated
+  BlockExit    exit      = EXIT_SEARCH;
+  BlockPattern pattern   = PATTERN_NONE;
+};
+
+/// Counters of all blocks in raster order
+typedef std::vector<BlockStats> BlockStatsField;
+
+/// Counters of one frame
+struct FrameStats
+{
+  int       frame           = 0;    ///< frame number of current frame
+  long long estimate_us     = 0;    ///< integer search time
+  long long subpixel_us     = 0;    ///< interpolation and refinement time
+  long long blocks          = 0;
+  long long sads            = 0;
+  long long steps           = 0;
+  long long subpixel        = 0;
+  long long median_stops    = 0;
+  long long temporal_stops  = 0;
+  long long predictor_stops = 0;
+  long long static_blocks   = 0;
+  long long small_patterns  = 0;
+  long long large_patterns  = 0;
+};
+
+
+/**
+ * Add up block counters of a frame
+ * @param blocks      block counters
+ * @param frame       frame to add to; times and frame number are kept
+ */
+void add_block_stats(const BlockStatsField &blocks, FrameStats &frame);
+
+/**
+ * Name of exit for export
+ * @param exit        how a block finished
+ * @return name
+ */
+const char *exit_name(BlockExit exit);
+
+/**
+ * Name of pattern for export
+ * @param pattern     pattern used
+ * @return name
+ */
+const char *pattern_name(BlockPattern pattern);
+
+
+/**
+ * StatsWriter
+ * @brief Writes frame and block counters, one frame at a time, as JSON if
+ *        the file name ends in .json, else as CSV. JSON holds an array of
+ *        frames, each with its totals and an array of blocks; CSV has one
+ *        row per block, with the frame totals on every row of the frame.
+ */
+class StatsWriter
+{
+public:
+  StatsWriter();
+  ~StatsWriter();
+
+  StatsWriter(const StatsWriter &) = delete;
+  StatsWriter &operator=(const StatsWriter &) = delete;
+
+  /**
+   * Create file, replacing any existing file
+   * @param filename    name of file
+   * @return true if success
+   */
+  bool open(const std::string &filename);
+
+  /**
+   * Append a frame
+   * @param frame       frame counters
+   * @param blocks      block counters in raster order
+   * @param blocks_wide blocks per row
+   * @return true if success
+   */
+  bool write(const FrameStats &frame, const BlockStatsField &blocks,
+             int blocks_wide);
+
+  /**
+   * Finish and close the file; also done on destruction
+   * @return true if success
+   */
+  bool close();
+
+private:
+  FILE *file_;
+  bool  json_;
+  int   frames_;
+};
+
+#endif    // blockstats_h
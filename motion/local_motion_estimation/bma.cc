@@ -12,23 +12,46 @@
  */
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
 #include <unistd.h>
-#include <string.h>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <chrono>
+#include <iomanip>
+#include <memory>
+#include <algorithm>
 
 #include <opencv2/core.hpp>
 #include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
 
-#include "fullsearch.h"
-#include "pmvfast.h"
+#include "estimate.h"
 #include "subpixel.h"
 #include "bmsupport.h"
+#include "mvfile.h"
+#include "blockstats.h"
+#include "framecache.h"
+#include "multireference.h"
 
 using namespace std::chrono;
 
+/// Most previous frames a frame can be matched against
+#define MAX_REFERENCES 16
+
+/// Settings for matching a pair of frames
+struct Settings : public EstimateSettings
+{
+  bool temporal     = true;    ///< temporal predictors in sequences
+  bool timing       = false;
+  bool counters     = false;
+  bool float_output = false;   ///< write cv::Vec2f rather than quarter pixels
+  int  references   = 1;       ///< previous frames matched in sequences
+  bool next_frame   = false;   ///< also match the next frame in sequences
+};
+
 
 // Help user
 void usage(const char *exe)
@@ -36,62 +59,372 @@ void usage(const char *exe)
   std::cout << exe << " usage:\n";
   std::cout << " -c  current image filename\n"
             << " -p  previous image filename\n"
-            << " -v  output motion vectors filename\n"
+            << " -s  sequence; video filename or image filename pattern, e.g.\n"
+            << "     frame_%05d.png, used instead of -c and -p\n"
+            << " -v  output motion vectors filename; for a sequence either one\n"
+            << "     file for all frames or a pattern with the current frame\n"
+            << "     number (default = vectors_%05d.mv)\n"
             << " -b  block size (default = 16)\n"
-            << " -a  algorithm, either 2dfs (default) or pmvfast\n"
-            << " -t  time the algorithm\n"
+            << " -a  algorithm (default = 2dfs), one of:\n";
+
+  for(const StrategyInfo &strategy : strategies())
+    std::cout << "       " << std::left << std::setw(14) << strategy.name
+              << strategy.description << "\n";
+
+  std::cout << " -l  pyramid levels for hierarchical, 2 to 4 (default = "
+            << HIER_LEVELS << ")\n"
+            << " -j  number of threads (default = 1, 0 = all cores)\n"
+            << " -t  time the algorithm; with -j also report speed-up\n"
+            << " -e  report SAD early termination counters; for PMVFAST in a\n"
+            << "     sequence also the early termination rate with and without\n"
+            << "     temporal predictors\n"
+            << " -n  no temporal predictors for PMVFAST, EPZS and\n"
+            << "     UMHexagonS in a sequence\n"
+            << " -f  write vectors as floating point rather than quarter\n"
+            << "     pixels, for older readers\n"
+            << " -i  write per frame and per block search statistics to a\n"
+            << "     JSON (if the name ends in .json) or CSV file\n"
+            << " -z  static threshold; blocks whose mean absolute difference\n"
+            << "     from the previous frame is at most this get a zero vector\n"
+            << "     without a search, and a skip map marking them is written\n"
+            << "     with the vectors (default = off)\n"
+            << " -m  smallest block size; with 2dfs also write a field at each\n"
+            << "     power of two block size from this one up to -b, all from\n"
+            << "     the SADs of the smallest blocks (default = off)\n"
+            << " -q  subpixel refinement: full (every quarter pixel offset),\n"
+            << "     twostage (half then quarter pixel neighbours) or\n"
+            << "     parabolic (fit to whole pixel SADs) (default = full)\n"
+            << " -d  search range in pixels for 2dfs and sea; with -g the\n"
+            << "     largest range (default = " << RANGE << ")\n"
+            << " -g  adaptive range margin; in a sequence each frame's range\n"
+            << "     is the " << RANGE_PERCENTILE << "th percentile of the "
+            << "previous frame's vector\n"
+            << "     lengths plus this many pixels (default = off)\n"
+            << " -k  with -g, size the range of each region of this many\n"
+            << "     blocks square separately (default = whole frame)\n"
+            << " -x  global motion: phase (phase correlation) or features\n"
+            << "     (median of ORB feature matches); 2dfs and sea also\n"
+            << "     search a window centred on it and PMVFAST adds it to\n"
+            << "     its predictors (default = none)\n"
+            << " -r  number of previous frames to match each frame of a\n"
+            << "     sequence against, up to " << MAX_REFERENCES << "; each "
+            << "block keeps the best,\n"
+            << "     and a reference map of the frame offsets chosen is\n"
+            << "     written with the vectors if there is more than one\n"
+            << "     (default = 1)\n"
+            << " -u  also match each frame of a sequence against the next\n"
+            << "     frame, writing a reference map\n"
             << " -h  help; this message\n";
 }
 
-int main(int argc, char *argv[])
+// Report SAD early termination counters
+void print_sad_counters(const char *stage)
 {
-  std::string current_filename, previous_filename;
-  std::string output_filename("motion_vectors.mv");
+  SADCounters c = sad_counters();
 
-  int  blocksize = 16;
-  bool alg_pmvfast = false;
-  bool timing = false;
-  int  c;
+  std::cout << stage << " SAD early termination: " << c.terminated << " of "
+            << c.calls << " calls, " << c.rows_skipped << " of " << c.rows
+            << " rows skipped ("
+            << 100.0*c.rows_skipped/std::max(1LL, c.rows) << "%)\n";
+}
+
+// Report PMVFAST early termination rate
+void print_pmvfast_stats(const char *label, const PMVFASTStats &stats)
+{
+  long long stops = stats.median_stops + stats.temporal_stops;
+
+  std::cout << "PMVFAST early termination " << label << ": " << stops
+            << " of " << stats.blocks << " blocks ("
+            << 100.0*stops/std::max(1LL, stats.blocks) << "%), "
+            << stats.median_stops << " at median, " << stats.temporal_stops
+            << " at co-located vector\n";
+}
+
+// Estimate motion between a pair of frames with estimator and refine it
+// to quarter pixels, and if instrumentation is not null write the search
+// statistics as frame frame_index. In a sequence previous_field is the
+// integer vector field of the previous pair, or null for the first, and
+// field is set to that of this pair.
+bool estimate_frames(PreparedFrame &current, PreparedFrame &previous,
+                     const Settings &settings, ThreadPool &pool,
+                     MotionEstimator &estimator, StatsWriter *instrumentation,
+                     int frame_index,
+                     const MotionField *previous_field = nullptr,
+                     MotionField *field = nullptr)
+{
+  const cv::Mat &current_img  = current.image();
+  const cv::Mat &previous_img = previous.image();
+
+  if(!settings.temporal) previous_field = nullptr;
+
+  estimator.reset_stats();
+
+  bool timed = settings.timing || instrumentation;
+  FrameStats frame_stats;
+  frame_stats.frame = frame_index;
+
+  // The serial run below must search the same ranges as this one
+
+  bool compare_serial = settings.timing && (pool.size() > 1);
+  RangeMap serial_ranges;
+  if(compare_serial) serial_ranges = estimator.ranges();
+
+  time_point<steady_clock> start;
+  microseconds duration(0);
+  if(timed) start = steady_clock::now();
+
+  const MotionField &mv = estimator.estimate(current, previous,
+                                             previous_field);
+  const SEAStats &sea_stats = estimator.sea_stats();
+
+  if(timed) {
+    time_point<steady_clock> stop = steady_clock::now();
+    duration = duration_cast<microseconds>(stop - start);
+    frame_stats.estimate_us = duration.count();
+  }
+
+  if(settings.timing) {
+    std::cout << "Time taken: " << duration.count() << " microseconds\n";
+
+    if(settings.static_threshold >= 0)
+      std::cout << "Static blocks: " << estimator.stats().static_blocks
+                << " of " << mv.size() << "\n";
+
+    if(settings.global_motion != GLOBAL_NONE)
+    {
+      cv::Vec2f global = mv_to_float(estimator.global_motion());
+      std::cout << "Global motion: (" << global[0] << ", " << global[1]
+                << ") pixels\n";
+    }
+
+    if(settings.adaptive_range)
+    {
+      const EstimateStats &stats = estimator.stats();
+      std::cout << "Mean search range: "
+                << (double)stats.range_total/std::max(1LL, stats.range_blocks)
+                << " pixels\n";
+    }
+
+    if(settings.algorithm == "sea")
+    {
+      std::cout << "Eliminated " << sea_stats.eliminated << " of "
+                << sea_stats.candidates << " candidates ("
+                << 100.0*sea_stats.eliminated/std::max(1LL, sea_stats.candidates)
+                << "%)\n";
+    }
+  }
 
-  while((c = getopt(argc, argv, "c:p:v:b:a:th")) != -1)
+  if(settings.counters)
   {
-    switch(c) {
-      case 'c': current_filename  = optarg;            break;
-      case 'p': previous_filename = optarg;            break;
-      case 'v': output_filename   = optarg;            break;
-      case 'b': blocksize         = std::stoi(optarg); break;
-      case 'a':
+    print_sad_counters("Search");
+
+    // Compare early termination with spatial predictors only
+
+    if(settings.algorithm == "pmvfast")
+    {
+      print_pmvfast_stats(previous_field ? "with temporal predictors" :
+                                           "with spatial predictors",
+                          estimator.pmvfast_stats());
+
+      if(previous_field)
       {
-        if(!strncmp(optarg, "pmvfast", 7))
-          alg_pmvfast = true;
-        break;
+        PMVFASTStats spatial_stats;
+        estimate(current_img, previous_img, settings, nullptr, nullptr,
+                 nullptr, &spatial_stats);
+        print_pmvfast_stats("without temporal predictors", spatial_stats);
       }
-      case 't': timing = true;                         break;
-      case 'h': usage(argv[0]); return(EXIT_SUCCESS);  break;
     }
   }
 
-  // Check inputs
+  if(field) *field = mv;
 
-  if(current_filename.empty() || previous_filename.empty())
+  // Compare against a serial run to get the speed-up
+
+  if(compare_serial)
   {
-    std::cout << "Error: image filename was not specified\n";
-    return(EXIT_FAILURE);
+    MotionEstimator serial_estimator(settings);
+    serial_estimator.set_ranges(serial_ranges);
+
+    start = steady_clock::now();
+    serial_estimator.estimate(current_img, previous_img, previous_field);
+    time_point<steady_clock> stop = steady_clock::now();
+    auto serial = duration_cast<microseconds>(stop - start);
+
+    std::cout << "Serial time taken: " << serial.count() << " microseconds, "
+              << "speed-up " << (double)(serial.count())/duration.count()
+              << " with " << pool.size() << " threads\n";
   }
 
-  // Load images
+  // Subpixel refinement of motion vectors
 
-  cv::Mat current_img, previous_img;
-  current_img  = cv::imread(current_filename.c_str(), cv::IMREAD_GRAYSCALE);
-  previous_img = cv::imread(previous_filename.c_str(), cv::IMREAD_GRAYSCALE);
+  reset_sad_counters();
+  if(timed) start = steady_clock::now();
 
-  // Check image dimensions
+  estimator.interpolate(previous);
+  estimator.refine(current_img);
+
+  if(timed)
+    frame_stats.subpixel_us =
+      duration_cast<microseconds>(steady_clock::now() - start).count();
+
+  if(settings.counters) print_sad_counters("Subpixel");
+
+  if(instrumentation)
+  {
+    add_block_stats(estimator.block_stats(), frame_stats);
+
+    if(!instrumentation->write(frame_stats, estimator.block_stats(),
+                               current_img.cols/settings.blocksize))
+    {
+      std::cout << "Error saving search statistics\n";
+      return(false);
+    }
+  }
+
+  reset_sad_counters();
+
+  return(true);
+}
+
+// Write the vectors of a frame to output as frame frame_index, with its
+// skip and reference maps if not null and the fields at smaller block
+// sizes after it, each with its skip map from smaller_skip if there is one
+bool write_fields(MVWriter &output, const Settings &settings,
+                  const cv::Mat &current_img, int frame_index,
+                  const MotionField &mv, const SkipMap *skip,
+                  const ReferenceMap *references,
+                  const std::vector<MotionField> &smaller,
+                  const std::vector<SkipMap> &smaller_skip)
+{
+  MVFieldInfo info;
+  info.width       = current_img.cols;
+  info.height      = current_img.rows;
+  info.block_size  = settings.blocksize;
+  info.frame_index = frame_index;
+  info.algorithm   = settings.algorithm;
+
+  bool written = settings.float_output ?
+                   output.write(info, mv_to_float(mv), skip, references) :
+                   output.write(info, mv, skip, references);
+
+  // Fields at smaller block sizes follow, smallest first
+
+  for(size_t i = 0; written && (i < smaller.size()); i++)
+  {
+    const SkipMap *flags = (i < smaller_skip.size()) ? &smaller_skip[i] :
+                                                       nullptr;
 
+    info.block_size = settings.min_blocksize << i;
+    written = settings.float_output ?
+                output.write(info, mv_to_float(smaller[i]), flags) :
+                output.write(info, smaller[i], flags);
+  }
+
+  if(!written)
+  {
+    std::cout << "Error saving output vectors\n";
+    return(false);
+  }
+
+  return(true);
+}
+
+// Estimate motion between a pair of frames with estimator and write the
+// vectors to output as frame frame_index; see estimate_frames()
+bool match_frames(PreparedFrame &current, PreparedFrame &previous,
+                  const Settings &settings, ThreadPool &pool,
+                  MotionEstimator &estimator, MVWriter &output,
+                  StatsWriter *instrumentation, int frame_index,
+                  const MotionField *previous_field = nullptr,
+                  MotionField *field = nullptr)
+{
+  if(!estimate_frames(current, previous, settings, pool, estimator,
+                      instrumentation, frame_index, previous_field, field))
+    return(false);
+
+  return(write_fields(output, settings, current.image(), frame_index,
+                      estimator.field(), &estimator.skip_map(), nullptr,
+                      estimator.smaller_fields(),
+                      estimator.smaller_skip_maps()));
+}
+
+// Frame offset of a reference slot; the previous frames come first, the
+// nearest first, then the next frame
+int reference_offset(const Settings &settings, int slot)
+{
+  return((slot < settings.references) ? -(slot+1) : 1);
+}
+
+// Estimate motion of a frame against each of its references, with the
+// estimator and fields of its slot, and write the vectors of the best
+// reference of each block with a reference map as frame frame_index.
+// references holds the frame of each slot, or null if the sequence has no
+// such frame. mv, chosen and skip hold the vectors, reference map and skip
+// map written.
+bool match_references(PreparedFrame &current,
+                      const std::vector<PreparedFrame *> &references,
+                      const Settings &settings, ThreadPool &pool,
+                      std::vector<std::unique_ptr<MotionEstimator>> &estimators,
+                      MVWriter &output, int frame_index,
+                      const std::vector<MotionField> &previous_fields,
+                      std::vector<MotionField> &fields, MotionField &mv,
+                      ReferenceMap &chosen, SkipMap &skip)
+{
+  std::vector<ReferenceField> candidates;
+
+  for(size_t slot = 0; slot < references.size(); slot++)
+  {
+    fields[slot].clear();
+    if(!references[slot]) continue;
+
+    int offset = reference_offset(settings, (int)slot);
+    MotionEstimator &estimator = *estimators[slot];
+
+    if(settings.timing || settings.counters)
+      std::cout << "Reference " << std::showpos << offset << std::noshowpos
+                << "\n";
+
+    if(!estimate_frames(current, *references[slot], settings, pool, estimator,
+                        nullptr, frame_index,
+                        previous_fields[slot].empty() ? nullptr :
+                                                        &previous_fields[slot],
+                        &fields[slot]))
+      return(false);
+
+    const SkipMap &static_blocks = estimator.skip_map();
+
+    candidates.push_back({ offset, &estimator.reference(), &estimator.field(),
+                           static_blocks.empty() ? nullptr : &static_blocks });
+  }
+
+  choose_references(current.image(), candidates, settings.blocksize,
+                    (pool.size() > 1) ? &pool : nullptr, mv, chosen, skip);
+
+  if(settings.timing)
+  {
+    std::cout << "Blocks per reference:";
+
+    for(const ReferenceField &candidate : candidates)
+      std::cout << " " << std::showpos << candidate.offset << std::noshowpos
+                << ": " << std::count(chosen.begin(), chosen.end(),
+                                     candidate.offset);
+    std::cout << "\n";
+  }
+
+  return(write_fields(output, settings, current.image(), frame_index, mv,
+                      &skip, &chosen, std::vector<MotionField>(),
+                      std::vector<SkipMap>()));
+}
+
+// Check that frame dimensions match and are multiples of the block size
+bool check_dimensions(const cv::Mat &current_img, const cv::Mat &previous_img,
+                      int blocksize)
+{
   if((current_img.rows != previous_img.rows) ||
      (current_img.cols != previous_img.cols))
   {
     std::cout << "Error: image dimensions do not match\n";
-    return(EXIT_FAILURE);
+    return(false);
   }
 
   // Make sure images can be represented by block size
@@ -99,35 +432,415 @@ int main(int argc, char *argv[])
   {
     std::cout << "Error: image dimensions must be a multiple of block size.\n";
     std::cout << "       Try setting the -b parameter\n";
+    return(false);
+  }
+
+  return(true);
+}
+
+// Convert a decoded frame to luma
+void luma(const cv::Mat &frame, cv::Mat &grey)
+{
+  if(frame.channels() == 1)
+    frame.copyTo(grey);
+  else
+    cv::cvtColor(frame, grey, cv::COLOR_BGR2GRAY);
+}
+
+// True if a per frame output pattern has exactly one integer conversion
+// for the frame number, such as %05d, and no other %, so that it is safe to
+// give to snprintf()
+bool frame_pattern_valid(const std::string &pattern)
+{
+  size_t percent = pattern.find('%');
+
+  if((percent == std::string::npos) ||
+     (pattern.find('%', percent+1) != std::string::npos))
+    return(false);
+
+  size_t i = percent+1;
+
+  while((i < pattern.size()) &&
+        (std::string("-+ #0").find(pattern[i]) != std::string::npos)) i++;
+  while((i < pattern.size()) && isdigit((unsigned char)pattern[i])) i++;
+
+  return((i < pattern.size()) && ((pattern[i] == 'd') || (pattern[i] == 'i')));
+}
+
+// Estimate motion for every frame of a sequence after the first against
+// the frame before it or, with more references or the next frame, against
+// each of them, keeping the best for each block. Frames are numbered from
+// 1, so the first field is for frame 2. If the output name contains a %
+// format the field of each frame is written to a file named by formatting
+// it with the frame number, otherwise all fields are written to one file.
+bool match_sequence(const std::string &sequence_name,
+                    const std::string &output_name,
+                    const Settings &settings, ThreadPool &pool,
+                    StatsWriter *instrumentation)
+{
+  cv::VideoCapture sequence(sequence_name);
+
+  if(!sequence.isOpened())
+  {
+    std::cout << "Error: could not open sequence " << sequence_name << "\n";
+    return(false);
+  }
+
+  // Decoded frames and the data derived from them are kept for as long as
+  // a later frame refers to them, so each is only prepared once: the
+  // references, the current frame and, to match the next frame, one ahead
+
+  int slots = settings.references + (settings.next_frame ? 1 : 0);
+
+  FrameCache cache(slots + 1);
+  cv::Mat frame, grey;
+  int decoded = 0;
+
+  auto decode = [&]() -> PreparedFrame *
+  {
+    if(!sequence.read(frame)) return(nullptr);
+
+    luma(frame, grey);
+    return(&cache.add(grey, ++decoded));
+  };
+
+  if(!decode())
+  {
+    std::cout << "Error: sequence has no frames\n";
+    return(false);
+  }
+
+  PreparedFrame *current = decode();
+  PreparedFrame *next = nullptr;
+
+  if(!current)
+  {
+    std::cout << "Error: sequence has only one frame\n";
+    return(false);
+  }
+
+  char output_filename[4096];
+  bool per_frame = (output_name.find('%') != std::string::npos);
+
+  MVWriter output;
+
+  if(!per_frame && !output.open(output_name))
+  {
+    std::cout << "Error: could not create " << output_name << "\n";
+    return(false);
+  }
+
+  // An estimator and integer vector fields of this and the previous frame
+  // for each reference slot, so temporal predictors and adaptive ranges
+  // follow the same reference; all are reused for every frame
+
+  std::vector<std::unique_ptr<MotionEstimator>> estimators;
+
+  for(int slot = 0; slot < slots; slot++)
+  {
+    estimators.push_back(std::make_unique<MotionEstimator>(
+                           settings, (pool.size() > 1) ? &pool : nullptr));
+    estimators.back()->enable_block_stats(instrumentation != nullptr);
+  }
+
+  std::vector<MotionField> fields(slots), previous_fields(slots);
+  std::vector<PreparedFrame *> references(slots);
+
+  MotionField  chosen_field;
+  ReferenceMap chosen;
+  SkipMap      chosen_skip;
+
+  while(current)
+  {
+    int frame_number = current->index();
+
+    if(settings.next_frame) next = decode();
+
+    if(!check_dimensions(current->image(), cache.find(frame_number-1)->image(),
+                         settings.blocksize) ||
+       (next && !check_dimensions(next->image(), current->image(),
+                                  settings.blocksize)))
+      return(false);
+
+    for(int slot = 0; slot < slots; slot++)
+    {
+      int offset = reference_offset(settings, slot);
+      references[slot] = (offset > 0) ? next :
+                                        cache.find(frame_number + offset);
+    }
+
+    if(per_frame)
+    {
+      snprintf(output_filename, sizeof(output_filename), output_name.c_str(),
+               frame_number);
+
+      if(!output.open(output_filename))
+      {
+        std::cout << "Error: could not create " << output_filename << "\n";
+        return(false);
+      }
+    }
+
+    if(settings.timing || settings.counters)
+      std::cout << "Frame " << frame_number << "\n";
+
+    bool matched = (slots > 1) ?
+      match_references(*current, references, settings, pool, estimators,
+                       output, frame_number, previous_fields, fields,
+                       chosen_field, chosen, chosen_skip) :
+      match_frames(*current, *references[0], settings, pool, *estimators[0],
+                   output, instrumentation, frame_number,
+                   previous_fields[0].empty() ? nullptr : &previous_fields[0],
+                   &fields[0]);
+
+    if(!matched) return(false);
+
+    if(per_frame && !output.close())
+    {
+      std::cout << "Error saving output vectors\n";
+      return(false);
+    }
+
+    // Fields of this frame are the previous ones of the next
+    std::swap(fields, previous_fields);
+
+    current = settings.next_frame ? next : decode();
+  }
+
+  if(settings.timing)
+  {
+    PreparedStats prepared = cache.stats();
+
+    std::cout << "Prepared " << prepared.frames << " frames: "
+              << prepared.references << " quarter pixel plane sets, "
+              << prepared.pyramids << " pyramids, " << prepared.sea_planes
+              << " sub-block sum sets\n";
+  }
+
+  if(!per_frame && !output.close())
+  {
+    std::cout << "Error saving output vectors\n";
+    return(false);
+  }
+
+  return(true);
+}
+
+int main(int argc, char *argv[])
+{
+  std::string current_filename, previous_filename, sequence_name;
+  std::string output_filename, stats_filename;
+
+  Settings settings;
+  int  threads = 1;
+  bool range_set = false;
+  int  c;
+  std::string subpixel_name, global_name;
+
+  while((c = getopt(argc, argv, "c:p:s:v:b:a:l:j:tenfi:z:m:q:d:g:k:x:r:uh")) != -1)
+  {
+    switch(c) {
+      case 'c': current_filename   = optarg;            break;
+      case 'p': previous_filename  = optarg;            break;
+      case 's': sequence_name      = optarg;            break;
+      case 'v': output_filename    = optarg;            break;
+      case 'b': settings.blocksize = std::stoi(optarg); break;
+      case 'a': settings.algorithm = optarg;            break;
+      case 'l': settings.levels    = std::stoi(optarg); break;
+      case 'j': threads            = std::stoi(optarg); break;
+      case 't': settings.timing    = true;              break;
+      case 'e': settings.counters  = true;              break;
+      case 'n': settings.temporal  = false;             break;
+      case 'f': settings.float_output = true;           break;
+      case 'i': stats_filename     = optarg;            break;
+      case 'z': settings.static_threshold = std::stof(optarg); break;
+      case 'm': settings.min_blocksize = std::stoi(optarg); break;
+      case 'q': subpixel_name      = optarg;            break;
+      case 'd': settings.range     = std::stoi(optarg);
+                range_set          = true;              break;
+      case 'g': settings.adaptive_range = true;
+                settings.range_margin   = std::stoi(optarg); break;
+      case 'k': settings.range_region   = std::stoi(optarg); break;
+      case 'x': global_name        = optarg;            break;
+      case 'r': settings.references = std::stoi(optarg); break;
+      case 'u': settings.next_frame = true;             break;
+      case 'h': usage(argv[0]); return(EXIT_SUCCESS);   break;
+    }
+  }
+
+  const StrategyInfo *strategy = find_strategy(settings.algorithm);
+
+  if(!strategy)
+  {
+    std::cout << "Error: unknown algorithm " << settings.algorithm << "\n";
     return(EXIT_FAILURE);
   }
 
-  // Run block matching
+  if((range_set || settings.adaptive_range) && !strategy->uses_range)
+  {
+    std::cout << "Error: -d and -g need an algorithm with a search range, "
+              << "such as 2dfs or sea\n";
+    return(EXIT_FAILURE);
+  }
 
-  std::vector<cv::Vec2f> mv;
+  if(!subpixel_name.empty() &&
+     !find_subpixel_mode(subpixel_name, settings.subpixel))
+  {
+    std::cout << "Error: unknown subpixel refinement " << subpixel_name << "\n";
+    return(EXIT_FAILURE);
+  }
 
-  time_point<steady_clock> start;
-  if(timing) start = steady_clock::now();
+  if(!global_name.empty() &&
+     !find_global_motion_method(global_name, settings.global_motion))
+  {
+    std::cout << "Error: unknown global motion method " << global_name << "\n";
+    return(EXIT_FAILURE);
+  }
 
-  if(alg_pmvfast)
-    mv = pmvfast(current_img, previous_img, blocksize);
-  else
-    mv = fullsearch(current_img, previous_img, blocksize);
+  if((settings.global_motion != GLOBAL_NONE) && !strategy->uses_global)
+  {
+    std::cout << "Error: -x needs an algorithm that uses global motion, "
+              << "such as 2dfs, sea or pmvfast\n";
+    return(EXIT_FAILURE);
+  }
 
-  if(timing) {
-    time_point<steady_clock> stop = steady_clock::now();
-    auto duration = duration_cast<microseconds>(stop - start);
-    std::cout << "Time taken: " << duration.count() << " microseconds\n";
+  if((settings.range < 1) || (settings.range_margin < 1) ||
+     (settings.range_region < 0))
+  {
+    std::cout << "Error: -d and -g must be at least 1 and -k at least 0\n";
+    return(EXIT_FAILURE);
   }
 
-  // Subpixel refinement of motion vectors
-  subpixel_search(current_img, previous_img, blocksize, mv);
+  if((settings.references < 1) || (settings.references > MAX_REFERENCES))
+  {
+    std::cout << "Error: -r must be from 1 to " << MAX_REFERENCES << "\n";
+    return(EXIT_FAILURE);
+  }
+
+  bool multiple = (settings.references > 1) || settings.next_frame;
+
+  if(multiple && (sequence_name.empty() || settings.min_blocksize ||
+                  !stats_filename.empty()))
+  {
+    std::cout << "Error: -r and -u need a sequence, and not -m or -i\n";
+    return(EXIT_FAILURE);
+  }
+
+  if(settings.min_blocksize)
+  {
+    if(!strategy->uses_multisize)
+    {
+      std::cout << "Error: -m needs an algorithm with multi-size search, "
+                << "such as 2dfs\n";
+      return(EXIT_FAILURE);
+    }
+
+    if(!multisize_supported(settings.min_blocksize, settings.blocksize))
+    {
+      std::cout << "Error: -m and -b must be powers of two from "
+                << MULTISIZE_MIN << " to " << MULTISIZE_MAX
+                << " with -m less than -b\n";
+      return(EXIT_FAILURE);
+    }
+  }
+
+  ThreadPool pool(threads);
+  enable_sad_counters(settings.counters);
+
+  StatsWriter stats_output;
+  StatsWriter *instrumentation = nullptr;
+
+  if(!stats_filename.empty())
+  {
+    if(!stats_output.open(stats_filename))
+    {
+      std::cout << "Error: could not create " << stats_filename << "\n";
+      return(EXIT_FAILURE);
+    }
+
+    instrumentation = &stats_output;
+  }
+
+  // Sequence mode
+
+  if(!sequence_name.empty())
+  {
+    if(output_filename.empty()) output_filename = "vectors_%05d.mv";
+
+    if((output_filename.find('%') != std::string::npos) &&
+       !frame_pattern_valid(output_filename))
+    {
+      std::cout << "Error: -v pattern must have one integer conversion for "
+                << "the frame number, e.g. %05d, and no other %\n";
+      return(EXIT_FAILURE);
+    }
+
+    if(!match_sequence(sequence_name, output_filename, settings, pool,
+                       instrumentation))
+      return(EXIT_FAILURE);
+
+    if(instrumentation && !stats_output.close())
+    {
+      std::cout << "Error saving search statistics\n";
+      return(EXIT_FAILURE);
+    }
+
+    return(EXIT_SUCCESS);
+  }
 
-  if(!save_vectors(mv, output_filename))
+  // Check inputs
+
+  if(current_filename.empty() || previous_filename.empty())
+  {
+    std::cout << "Error: image filename was not specified\n";
+    return(EXIT_FAILURE);
+  }
+
+  if(output_filename.empty()) output_filename = "motion_vectors.mv";
+
+  // Load images
+
+  cv::Mat current_img, previous_img;
+  current_img  = cv::imread(current_filename.c_str(), cv::IMREAD_GRAYSCALE);
+  previous_img = cv::imread(previous_filename.c_str(), cv::IMREAD_GRAYSCALE);
+
+  // Check image dimensions
+
+  if(!check_dimensions(current_img, previous_img, settings.blocksize))
+    return(EXIT_FAILURE);
+
+  // Run block matching
+
+  MVWriter output;
+
+  if(!output.open(output_filename))
+  {
+    std::cout << "Error: could not create " << output_filename << "\n";
+    return(EXIT_FAILURE);
+  }
+
+  MotionEstimator estimator(settings, (pool.size() > 1) ? &pool : nullptr);
+  estimator.enable_block_stats(instrumentation != nullptr);
+
+  PreparedFrame current, previous;
+  current.set(current_img);
+  previous.set(previous_img);
+
+  if(!match_frames(current, previous, settings, pool, estimator, output,
+                   instrumentation, 0))
+    return(EXIT_FAILURE);
+
+  if(!output.close())
   {
     std::cout << "Error saving output vectors\n";
     return(EXIT_FAILURE);
   }
 
+  if(instrumentation && !stats_output.close())
+  {
+    std::cout << "Error saving search statistics\n";
+    return(EXIT_FAILURE);
+  }
+
   return(EXIT_SUCCESS);
 }
@@ -17,6 +17,7 @@
 
 #include "blockcompensate.h"
 #include "bmsupport.h"
+#include "mvfile.h"
 
 
 // Help user
@@ -25,8 +26,13 @@ void usage(const char *exe)
   std::cout << exe << " usage:\n";
   std::cout << " -p  previous image filename\n"
             << " -v  input motion vectors filename\n"
-            << " -b  block size (default = 16)\n"
+            << " -b  block size; read from the vectors file unless it is a\n"
+            << "     legacy raw file (default = 16); if the file has fields at\n"
+            << "     several block sizes, the field of this size is used\n"
+            << " -f  frame number of the vectors to use from a file holding a\n"
+            << "     sequence (default = first in file)\n"
             << " -o  output image filename\n"
+            << " -j  number of threads (default = 1, 0 = all cores)\n"
             << " -h  help; this message\n";
 }
 
@@ -34,16 +40,20 @@ int main(int argc, char *argv[])
 {
   std::string previous_filename, motion_filename;
   std::string output_filename;
-  int blocksize = 16;
+  int blocksize = 0;
+  int frame_index = -1;
+  int threads = 1;
 
   int c;
-  while((c = getopt(argc, argv, "p:v:b:o:h")) != -1)
+  while((c = getopt(argc, argv, "p:v:b:f:o:j:h")) != -1)
   {
     switch(c) {
       case 'p': previous_filename = optarg;            break;
       case 'v': motion_filename   = optarg;            break;
       case 'b': blocksize         = std::stoi(optarg); break;
+      case 'f': frame_index       = std::stoi(optarg); break;
       case 'o': output_filename   = optarg;            break;
+      case 'j': threads           = std::stoi(optarg); break;
       case 'h': usage(argv[0]); return(EXIT_SUCCESS);  break;
     }
   }
@@ -64,44 +74,101 @@ int main(int argc, char *argv[])
 
   // Load motion vectors
 
-  std::vector<cv::Vec2f> mv;
-  if(!load_vectors(motion_filename, mv))
+  MVReader reader;
+  if(!reader.open(motion_filename) || (reader.frames() < 1))
   {
     std::cout << "Error: could not load motion vectors\n";
     return(EXIT_FAILURE);
   }
 
-  // Check motion vectors match dimensions
-  if(mv.size() != (previous_img.cols/blocksize)*(previous_img.rows/blocksize))
+  // A file may hold fields of the same frame at several block sizes
+
+  int field = 0;
+  int field_size = reader.legacy() ? 0 : blocksize;
+
+  if((frame_index < 0) && field_size) frame_index = reader.info(0).frame_index;
+  if(frame_index >= 0) field = reader.find(frame_index, field_size);
+
+  if(field < 0)
   {
-    std::cout << "Error: motion vectors do not match images with the specified "
-              << "block size\n";
+    std::cout << "Error: no motion vectors for frame " << frame_index;
+    if(field_size) std::cout << " with block size " << field_size;
+    std::cout << "\n";
     return(EXIT_FAILURE);
   }
 
-  // Block motion compensation
+  const MVFieldInfo &info = reader.info(field);
 
-  cv::Mat output_img;
+  // The file gives the block size and image dimensions, except for legacy
+  // files
 
-  if(previous_img.channels() == 1)
-    block_compensate(previous_img, mv, blocksize, output_img);
-  else
+  if(!reader.legacy())
   {
-    // Split into separate colour channels and process individually
+    if(blocksize && (blocksize != info.block_size))
+    {
+      std::cout << "Error: motion vectors have block size " << info.block_size
+                << ", not " << blocksize << "\n";
+      return(EXIT_FAILURE);
+    }
 
-    std::vector<cv::Mat> channels(previous_img.channels());
-    cv::split(previous_img, channels);
+    blocksize = info.block_size;
 
-    for(int chan = 0; chan < channels.size(); chan++)
+    if((info.width != previous_img.cols) || (info.height != previous_img.rows))
     {
-      block_compensate(channels[chan], mv, blocksize, output_img);
-      channels[chan] = output_img;
+      std::cout << "Error: motion vectors are for " << info.width << "x"
+                << info.height << " images\n";
+      return(EXIT_FAILURE);
     }
+  }
+  else if(!blocksize)
+    blocksize = 16;
+
+  MotionField mv;
+  if(!reader.field(field, mv))
+  {
+    std::cout << "Error: could not load motion vectors\n";
+    return(EXIT_FAILURE);
+  }
+
+  // Check motion vectors match dimensions
+  if(mv.size() != (previous_img.cols/blocksize)*(previous_img.rows/blocksize))
+  {
+    std::cout << "Error: motion vectors do not match images with the specified "
+              << "block size\n";
+    return(EXIT_FAILURE);
+  }
 
-    // Join channels together
-    cv::merge(channels, output_img);
+  // Blocks of a multi-reference field may need frames other than the
+  // previous one
+
+  if(const signed char *references = reader.reference_map(field))
+  {
+    for(size_t i = 0; i < mv.size(); i++)
+    {
+      if(references[i] != -1)
+      {
+        std::cout << "Error: motion vectors refer to frames other than the "
+                  << "previous one\n";
+        return(EXIT_FAILURE);
+      }
+    }
   }
 
+  // Block motion compensation; all channels in one pass
+
+  ThreadPool pool(threads);
+  cv::Mat output_img;
+
+  // Static blocks in the skip map, if the file has one, are copied
+
+  SkipMap skip;
+  if(const unsigned char *flags = reader.skip_map(field))
+    skip.assign(flags, flags + mv.size());
+
+  block_compensate(previous_img, mv, blocksize, output_img,
+                   (pool.size() > 1) ? &pool : nullptr,
+                   skip.empty() ? nullptr : &skip);
+
   // Save output image
 
   cv::imwrite(output_filename.c_str(), output_img);
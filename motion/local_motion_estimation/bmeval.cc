@@ -0,0 +1,441 @@
+/**
+ * @file   bmeval.cc
+ * @brief  Motion estimation and compensation evaluation tool
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ *
+ * Runs estimation, subpixel refinement, compensation and PSNR for every
+ * consecutive pair of frames of a sequence in memory, timing each stage,
+ * and writes the results in the CSV format read by plotresults.py and
+ * compare_algs.py.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "estimate.h"
+#include "subpixel.h"
+#include "blockcompensate.h"
+#include "interpolatedref.h"
+
+using namespace std::chrono;
+
+/// Results of one frame
+struct FrameResult
+{
+  int       frame;
+  double    psnr;
+  long long estimate_us;      ///< median time of each stage in microseconds
+  long long interpolate_us;
+  long long subpixel_us;
+  long long compensate_us;
+  double    full_psnr;        ///< with full subpixel refinement, if compared
+  long long full_subpixel_us;
+  double    range;            ///< mean search range, if adaptive
+};
+
+
+// Help user
+void usage(const char *exe)
+{
+  std::cout << exe << " usage:\n";
+  std::cout << " -s  sequence; video filename or image filename pattern, e.g.\n"
+            << "     frame_%05d.png\n"
+            << " -o  output CSV filename (default = evaluation_results.csv)\n"
+            << " -b  block size (default = 16)\n"
+            << " -a  algorithm (default = 2dfs), one of:\n";
+
+  for(const StrategyInfo &strategy : strategies())
+    std::cout << "       " << std::left << std::setw(14) << strategy.name
+              << strategy.description << "\n";
+
+  std::cout << " -l  pyramid levels for hierarchical, 2 to 4 (default = "
+            << HIER_LEVELS << ")\n"
+            << " -j  number of threads (default = 1, 0 = all cores)\n"
+            << " -n  no temporal predictors for PMVFAST, EPZS and UMHexagonS\n"
+            << " -w  number of untimed warm-up runs of each stage (default = 1)\n"
+            << " -r  number of timed runs of each stage (default = 5)\n"
+            << " -z  static threshold; blocks whose mean absolute difference\n"
+            << "     from the previous frame is at most this are not searched\n"
+            << "     (default = off)\n"
+            << " -q  subpixel refinement: full, twostage or parabolic; other\n"
+            << "     than full, also report the PSNR and subpixel time against\n"
+            << "     full (default = full)\n"
+            << " -d  search range in pixels for 2dfs and sea; with -g the\n"
+            << "     largest range (default = " << RANGE << ")\n"
+            << " -g  adaptive range margin; each frame's range is the "
+            << RANGE_PERCENTILE << "th\n"
+            << "     percentile of the previous frame's vector lengths plus\n"
+            << "     this many pixels, and the mean range is reported\n"
+            << "     (default = off)\n"
+            << " -k  with -g, size the range of each region of this many\n"
+            << "     blocks square separately (default = whole frame)\n"
+            << " -x  global motion: phase (phase correlation) or features\n"
+            << "     (median of ORB feature matches); 2dfs and sea also\n"
+            << "     search a window centred on it and PMVFAST adds it to\n"
+            << "     its predictors (default = none)\n"
+            << " -h  help; this message\n";
+}
+
+// Run a stage warmup times, then repeats times, returning the median time
+// in microseconds
+template<typename Stage>
+long long time_stage(int warmup, int repeats, Stage stage)
+{
+  for(int i = 0; i < warmup; i++) stage();
+
+  std::vector<long long> times(repeats);
+
+  for(int i = 0; i < repeats; i++)
+  {
+    time_point<steady_clock> start = steady_clock::now();
+    stage();
+    time_point<steady_clock> stop = steady_clock::now();
+    times[i] = duration_cast<microseconds>(stop - start).count();
+  }
+
+  std::nth_element(times.begin(), times.begin() + repeats/2, times.end());
+  return(times[repeats/2]);
+}
+
+// Convert a decoded frame to luma
+void luma(const cv::Mat &frame, cv::Mat &grey)
+{
+  if(frame.channels() == 1)
+    frame.copyTo(grey);
+  else
+    cv::cvtColor(frame, grey, cv::COLOR_BGR2GRAY);
+}
+
+int main(int argc, char *argv[])
+{
+  std::string sequence_name;
+  std::string output_filename("evaluation_results.csv");
+
+  EstimateSettings settings;
+  int  threads  = 1;
+  bool temporal = true;
+  int  warmup   = 1;
+  int  repeats  = 5;
+  bool range_set = false;
+  int  c;
+  std::string subpixel_name, global_name;
+
+  while((c = getopt(argc, argv, "s:o:b:a:l:j:nw:r:z:q:d:g:k:x:h")) != -1)
+  {
+    switch(c) {
+      case 's': sequence_name      = optarg;                  break;
+      case 'o': output_filename    = optarg;                  break;
+      case 'b': settings.blocksize = std::stoi(optarg);       break;
+      case 'a': settings.algorithm = optarg;                  break;
+      case 'l': settings.levels    = std::stoi(optarg);       break;
+      case 'j': threads            = std::stoi(optarg);       break;
+      case 'n': temporal           = false;                   break;
+      case 'w': warmup             = std::stoi(optarg);       break;
+      case 'r': repeats            = std::stoi(optarg);       break;
+      case 'z': settings.static_threshold = std::stof(optarg); break;
+      case 'q': subpixel_name      = optarg;                  break;
+      case 'd': settings.range     = std::stoi(optarg);
+                range_set          = true;                    break;
+      case 'g': settings.adaptive_range = true;
+                settings.range_margin   = std::stoi(optarg);  break;
+      case 'k': settings.range_region   = std::stoi(optarg);  break;
+      case 'x': global_name        = optarg;                  break;
+      case 'h': usage(argv[0]); return(EXIT_SUCCESS);         break;
+    }
+  }
+
+  // Check inputs
+
+  if(sequence_name.empty())
+  {
+    std::cout << "Error: sequence was not specified\n";
+    return(EXIT_FAILURE);
+  }
+
+  const StrategyInfo *strategy = find_strategy(settings.algorithm);
+
+  if(!strategy)
+  {
+    std::cout << "Error: unknown algorithm " << settings.algorithm << "\n";
+    return(EXIT_FAILURE);
+  }
+
+  if((range_set || settings.adaptive_range) && !strategy->uses_range)
+  {
+    std::cout << "Error: -d and -g need an algorithm with a search range, "
+              << "such as 2dfs or sea\n";
+    return(EXIT_FAILURE);
+  }
+
+  if(!subpixel_name.empty() &&
+     !find_subpixel_mode(subpixel_name, settings.subpixel))
+  {
+    std::cout << "Error: unknown subpixel refinement " << subpixel_name << "\n";
+    return(EXIT_FAILURE);
+  }
+
+  if(!global_name.empty() &&
+     !find_global_motion_method(global_name, settings.global_motion))
+  {
+    std::cout << "Error: unknown global motion method " << global_name << "\n";
+    return(EXIT_FAILURE);
+  }
+
+  if((settings.global_motion != GLOBAL_NONE) && !strategy->uses_global)
+  {
+    std::cout << "Error: -x needs an algorithm that uses global motion, "
+              << "such as 2dfs, sea or pmvfast\n";
+    return(EXIT_FAILURE);
+  }
+
+  if((settings.range < 1) || (settings.range_margin < 1) ||
+     (settings.range_region < 0))
+  {
+    std::cout << "Error: -d and -g must be at least 1 and -k at least 0\n";
+    return(EXIT_FAILURE);
+  }
+
+  bool compare = (settings.subpixel != SUBPIXEL_FULL);
+
+  warmup  = std::max(warmup, 0);
+  repeats = std::max(repeats, 1);
+
+  cv::VideoCapture sequence(sequence_name);
+
+  if(!sequence.isOpened())
+  {
+    std::cout << "Error: could not open sequence " << sequence_name << "\n";
+    return(EXIT_FAILURE);
+  }
+
+  cv::Mat frame, current_img, previous_img;
+
+  if(!sequence.read(frame))
+  {
+    std::cout << "Error: sequence has no frames\n";
+    return(EXIT_FAILURE);
+  }
+
+  luma(frame, previous_img);
+
+  if((previous_img.rows % settings.blocksize) ||
+     (previous_img.cols % settings.blocksize))
+  {
+    std::cout << "Error: image dimensions must be a multiple of block size.\n";
+    std::cout << "       Try setting the -b parameter\n";
+    return(EXIT_FAILURE);
+  }
+
+  ThreadPool pool(threads);
+  ThreadPool *estimate_pool = (pool.size() > 1) ? &pool : nullptr;
+
+  MotionEstimator estimator(settings, estimate_pool);
+
+  std::vector<FrameResult> results;
+  MotionField field, previous_field;
+  int frame_number = 1;
+
+  while(sequence.read(frame))
+  {
+    frame_number++;
+    luma(frame, current_img);
+
+    if((current_img.rows != previous_img.rows) ||
+       (current_img.cols != previous_img.cols))
+    {
+      std::cout << "Error: frame " << frame_number
+                << " dimensions do not match\n";
+      return(EXIT_FAILURE);
+    }
+
+    FrameResult result;
+    result.frame = frame_number;
+
+    // Estimation; the previous field gives temporal predictors
+
+    const MotionField *predictors =
+      (temporal && !previous_field.empty()) ? &previous_field : nullptr;
+
+    // Every run searches with the ranges from the previous frame
+
+    RangeMap ranges = estimator.ranges();
+
+    result.estimate_us = time_stage(warmup, repeats, [&]()
+    {
+      estimator.set_ranges(ranges);
+      estimator.estimate(current_img, previous_img, predictors);
+    });
+
+    result.range = settings.range;
+
+    if(!ranges.empty())
+    {
+      long long total = 0;
+      for(int r : ranges) total += r;
+      result.range = (double)total/ranges.size();
+    }
+
+    field = estimator.field();
+
+    // Interpolated previous frame, shared by subpixel and compensation
+
+    result.interpolate_us = time_stage(warmup, repeats, [&]()
+    {
+      estimator.interpolate(previous_img);
+    });
+
+    const InterpolatedReference &reference = estimator.reference();
+
+    // Static blocks keep their zero vector, as in MotionEstimator::refine()
+
+    const SkipMap *skip = estimator.skip_map().empty() ? nullptr :
+                                                         &estimator.skip_map();
+
+    // Subpixel refinement starts from the integer vectors on every run
+
+    MotionField mv;
+
+    result.subpixel_us = time_stage(warmup, repeats, [&]()
+    {
+      mv = field;
+      subpixel_search(current_img, reference, settings.blocksize, mv,
+                      nullptr, skip, settings.subpixel);
+    });
+
+    // Compensation and quality
+
+    cv::Mat compensated_img;
+
+    result.compensate_us = time_stage(warmup, repeats, [&]()
+    {
+      block_compensate(reference, mv, settings.blocksize, compensated_img);
+    });
+
+    result.psnr = cv::PSNR(current_img, compensated_img);
+
+    // Full refinement of the same vectors for comparison
+
+    if(compare)
+    {
+      MotionField full_mv;
+
+      result.full_subpixel_us = time_stage(warmup, repeats, [&]()
+      {
+        full_mv = field;
+        subpixel_search(current_img, reference, settings.blocksize, full_mv,
+                        nullptr, skip, SUBPIXEL_FULL);
+      });
+
+      block_compensate(reference, full_mv, settings.blocksize,
+                       compensated_img);
+      result.full_psnr = cv::PSNR(current_img, compensated_img);
+    }
+
+    results.push_back(result);
+
+    std::cout << "Frame " << frame_number << ": PSNR " << result.psnr
+              << " dB, estimate " << result.estimate_us << " us, subpixel "
+              << result.subpixel_us << " us, compensate "
+              << result.compensate_us << " us";
+
+    if(compare)
+      std::cout << "; against full " << std::showpos
+                << result.psnr - result.full_psnr << " dB, "
+                << result.subpixel_us - result.full_subpixel_us << " us"
+                << std::noshowpos;
+
+    if(settings.adaptive_range)
+      std::cout << "; mean range " << result.range << " pixels";
+
+    if(settings.global_motion != GLOBAL_NONE)
+    {
+      cv::Vec2f global = mv_to_float(estimator.global_motion());
+      std::cout << "; global (" << global[0] << ", " << global[1] << ")";
+    }
+
+    std::cout << "\n";
+
+    // Current frame and field are the previous ones of the next pair
+    std::swap(current_img, previous_img);
+    std::swap(field, previous_field);
+  }
+
+  if(results.empty())
+  {
+    std::cout << "Error: sequence has only one frame\n";
+    return(EXIT_FAILURE);
+  }
+
+  // Save results; the first three columns are those written by evaluate.py
+
+  std::ofstream output(output_filename);
+  if(!output)
+  {
+    std::cout << "Error: could not write " << output_filename << "\n";
+    return(EXIT_FAILURE);
+  }
+
+  // Comparisons with full refinement add two columns, adaptive ranges one
+
+  output << "FrameIndex,PSNR,TimeTakenMicroseconds,InterpolateMicroseconds,"
+         << "SubpixelMicroseconds,CompensateMicroseconds";
+  if(compare) output << ",FullPSNR,FullSubpixelMicroseconds";
+  if(settings.adaptive_range) output << ",MeanSearchRange";
+  output << "\n";
+
+  double psnr_total = 0, full_psnr_total = 0;
+  long long estimate_total = 0, subpixel_total = 0, full_subpixel_total = 0;
+
+  for(const FrameResult &r : results)
+  {
+    output << r.frame << "," << r.psnr << "," << r.estimate_us << ","
+           << r.interpolate_us << "," << r.subpixel_us << ","
+           << r.compensate_us;
+    if(compare) output << "," << r.full_psnr << "," << r.full_subpixel_us;
+    if(settings.adaptive_range) output << "," << r.range;
+    output << "\n";
+
+    psnr_total     += r.psnr;
+    estimate_total += r.estimate_us;
+    subpixel_total += r.subpixel_us;
+
+    if(compare)
+    {
+      full_psnr_total     += r.full_psnr;
+      full_subpixel_total += r.full_subpixel_us;
+    }
+  }
+
+  std::cout << "Mean PSNR " << psnr_total/results.size() << " dB, mean "
+            << "estimate time " << estimate_total/(long long)(results.size())
+            << " microseconds over " << results.size() << " frames\n";
+
+  if(compare)
+  {
+    std::cout << "Subpixel " << subpixel_mode_name(settings.subpixel)
+              << " against full: mean PSNR " << std::showpos
+              << (psnr_total - full_psnr_total)/results.size() << std::noshowpos
+              << " dB, mean subpixel time "
+              << subpixel_total/(long long)(results.size()) << " rather than "
+              << full_subpixel_total/(long long)(results.size())
+              << " microseconds ("
+              << (double)(full_subpixel_total)/std::max(1LL, subpixel_total)
+              << "x faster)\n";
+  }
+  std::cout << "Evaluation results saved to " << output_filename << "\n";
+
+  return(EXIT_SUCCESS);
+}
+
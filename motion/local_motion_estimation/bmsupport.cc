@@ -6,75 +6,216 @@
  */
 
 #include <cmath>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <mutex>
+#include <climits>
 
 #if __cplusplus >= 202002L
 #include <span>
 #endif
 
 #include "bmsupport.h"
+#include "sadkernels.h"
+#include "mvfile.h"
 
 
-// Bilinear interpolation
+// Early termination counters of one thread; plain data so that updating
+// them on the hot path is cheap. Each thread registers its counters on first
+// use so that they can be totalled; they are only read or reset when no
+// block matching is running.
+struct ThreadSADCounters
+{
+  long long calls, terminated, rows, rows_skipped;
+  bool      registered;
+};
+
+static thread_local ThreadSADCounters thread_counters;
+
+static std::mutex                       counters_mutex;
+static std::vector<ThreadSADCounters *> counters_list;
+static SADCounters                      finished_counters;   // exited threads
+static bool                             counting = false;
+
+// Registers a thread's counters and adds them to the totals at thread exit
+struct CountersRegistration
+{
+  CountersRegistration()
+  {
+    std::lock_guard<std::mutex> lock(counters_mutex);
+    counters_list.push_back(&thread_counters);
+    thread_counters.registered = true;
+  }
+
+  ~CountersRegistration()
+  {
+    std::lock_guard<std::mutex> lock(counters_mutex);
+
+    finished_counters.calls        += thread_counters.calls;
+    finished_counters.terminated   += thread_counters.terminated;
+    finished_counters.rows         += thread_counters.rows;
+    finished_counters.rows_skipped += thread_counters.rows_skipped;
+
+    counters_list.erase(std::find(counters_list.begin(), counters_list.end(),
+                                  &thread_counters));
+  }
+};
+
+static void register_counters()
+{
+  static thread_local CountersRegistration registration;
+}
+
+// Count a bounded SAD call
+static inline void count_bounded(int size, int rows_summed)
+{
+  if(!counting) return;
+
+  ThreadSADCounters &c = thread_counters;
+  if(!c.registered) register_counters();
+
+  c.calls++;
+  c.rows         += size;
+  c.terminated   += (rows_summed < size);
+  c.rows_skipped += size - rows_summed;
+}
+
+// Convert floating point bound to integer; a partial sum is greater than
+// the bound if it is greater than its integer part
+static inline unsigned int integer_bound(float bound)
+{
+  if(bound >= (float)(INT_MAX)) return(UINT_MAX);
+  if(bound < 0) return(0);
+  return((unsigned int)(bound));
+}
+
+
+// Bilinear interpolation in fixed point
 unsigned char interpolate(const cv::Mat &img, float fx, float fy)
 {
   if(img.channels() != 1) return(0);                  // Wrong image type
   if((fx >= img.cols) || (fy >= img.rows)) return(0); // Off image
 
-  int ix, iy;
-  float a, b;
+  return(interpolate_fixed(img, (int)(std::floor(fx*BILINEAR_ONE + 0.5f)),
+                           (int)(std::floor(fy*BILINEAR_ONE + 0.5f))));
+}
+
+// Interpolate a block at floating point co-ordinates into a buffer with
+// stride BILINEAR_STRIP, if they are quarter pixels and it fits
+static bool qpel_block(const cv::Mat &search, float sx, float sy, int size,
+                       unsigned char *block)
+{
+  float qx = sx*MV_UNIT;
+  float qy = sy*MV_UNIT;
+  int iqx = (int)(std::floor(qx));
+  int iqy = (int)(std::floor(qy));
+
+  if((iqx != qx) || (iqy != qy) || (size > BILINEAR_STRIP)) return(false);
 
-  ix = (int)(std::floor(fx));
-  iy = (int)(std::floor(fy));
-  a  = fx - (float)(ix);
-  b  = fy - (float)(iy);
+  interpolate_block(search, iqx, iqy, size, size, block, BILINEAR_STRIP);
+  return(true);
+}
+
+// Calculate block distortion metric
+float SAD(const cv::Mat &ref, const cv::Mat &search,
+          int rx, int ry, float sx, float sy, int size)
+{
+  // Integer positions inside the search image don't need interpolation
+
+  int isx = (int)(sx);
+  int isy = (int)(sy);
 
-  float g, h, i, j;     // Neighbouring pixel values
-  g = 0.0; h = 0.0; i = 0.0; j = 0.0;
+  if((isx == sx) && (isy == sy) && (isx >= 0) && (isy >= 0) &&
+     (isx+size <= search.cols) && (isy+size <= search.rows))
+    return(SAD_integer(ref, search, rx, ry, isx, isy, size));
 
-  int wide = img.cols; int high = img.rows;
-  int ix1 = ix+1;
-  int iy1 = iy+1;
+  unsigned char block[BILINEAR_STRIP*BILINEAR_STRIP];
 
-  if((ix >= 0) || (ix < wide))
+  if(qpel_block(search, sx, sy, size, block))
+    return(sad_block(ref.ptr<unsigned char>(ry) + rx, ref.step, block,
+                     BILINEAR_STRIP, size));
+
+  int x, y;
+  float sad = 0.0;
+
+  for(y = 0; y < size; y++)
   {
-    if(iy >= 0)
+    for(x = 0; x < size; x++)
     {
-      if(iy < high)  g = img.at<unsigned char>(iy, ix);
-      if(iy1 < high) h = img.at<unsigned char>(iy1, ix);
+      sad += std::abs(ref.at<unsigned char>(ry+y, rx+x) -
+                      interpolate(search, sx+x, sy+y));
     }
   }
 
-  if((ix1 >= 0) && (ix1 < wide))
+  return(sad);
+}
+
+// Calculate block distortion metric with interpolated search image
+float SAD(const cv::Mat &ref, const InterpolatedReference &search,
+          int rx, int ry, float sx, float sy, int size)
+{
+  float qx = sx*4;
+  float qy = sy*4;
+  int iqx = (int)(std::floor(qx));
+  int iqy = (int)(std::floor(qy));
+
+  if((iqx == qx) && (iqy == qy) &&
+     search.contains(iqx >> 2, iqy >> 2, size, size))
   {
-    if(iy >= 0)
-    {
-      if(iy < high)  i = img.at<unsigned char>(iy, ix1);
-      if(iy1 < high) j = img.at<unsigned char>(iy1, ix1);
-    }
+    return(sad_block(ref.ptr<unsigned char>(ry) + rx, ref.step,
+                     search.pixel(iqx >> 2, iqy >> 2, iqx & 3, iqy & 3),
+                     search.stride(), size));
   }
 
-  float oma, omb, omab;
-  oma = 1.0-a;
-  omb = 1.0-b;
-  omab = oma*omb;
-
-  float ab = a*b;
-  float aomb = a*omb;
-  float boma = b*oma;
+  return(SAD(ref, search.image(), rx, ry, sx, sy, size));
+}
 
-  return(std::roundf(omab*g + boma*h + aomb*i + ab*j));
+// Calculate block distortion metric at integer position
+int SAD_integer(const cv::Mat &ref, const cv::Mat &search,
+                int rx, int ry, int sx, int sy, int size)
+{
+  return(sad_block(ref.ptr<unsigned char>(ry) + rx, ref.step,
+                   search.ptr<unsigned char>(sy) + sx, search.step, size));
 }
 
-// Calculate block distortion metric
-float SAD(const cv::Mat &ref, const cv::Mat &search,
-          int rx, int ry, float sx, float sy, int size)
+// Bounded block distortion metric
+float SAD_bounded(const cv::Mat &ref, const cv::Mat &search,
+                  int rx, int ry, float sx, float sy, int size, float bound)
 {
+  // Integer positions inside the search image don't need interpolation
+
+  int isx = (int)(sx);
+  int isy = (int)(sy);
+
+  if((isx == sx) && (isy == sy) && (isx >= 0) && (isy >= 0) &&
+     (isx+size <= search.cols) && (isy+size <= search.rows))
+  {
+    int rows;
+    unsigned int sad = sad_block_bounded(ref.ptr<unsigned char>(ry) + rx, ref.step,
+                                         search.ptr<unsigned char>(isy) + isx,
+                                         search.step, size,
+                                         integer_bound(bound), rows);
+    count_bounded(size, rows);
+    return(sad);
+  }
+
+  unsigned char block[BILINEAR_STRIP*BILINEAR_STRIP];
+
+  if(qpel_block(search, sx, sy, size, block))
+  {
+    int rows;
+    unsigned int sad = sad_block_bounded(ref.ptr<unsigned char>(ry) + rx, ref.step,
+                                         block, BILINEAR_STRIP, size,
+                                         integer_bound(bound), rows);
+    count_bounded(size, rows);
+    return(sad);
+  }
+
   int x, y;
   float sad = 0.0;
 
-  for(y = 0; y < size; y++)
+  for(y = 0; (y < size) && (sad <= bound); y++)
   {
     for(x = 0; x < size; x++)
     {
@@ -83,9 +224,138 @@ float SAD(const cv::Mat &ref, const cv::Mat &search,
     }
   }
 
+  count_bounded(size, y);
+
   return(sad);
 }
 
+// Bounded block distortion metric with interpolated search image
+float SAD_bounded(const cv::Mat &ref, const InterpolatedReference &search,
+                  int rx, int ry, float sx, float sy, int size, float bound)
+{
+  float qx = sx*4;
+  float qy = sy*4;
+  int iqx = (int)(std::floor(qx));
+  int iqy = (int)(std::floor(qy));
+
+  if((iqx == qx) && (iqy == qy) &&
+     search.contains(iqx >> 2, iqy >> 2, size, size))
+  {
+    int rows;
+    unsigned int sad = sad_block_bounded(ref.ptr<unsigned char>(ry) + rx, ref.step,
+                                         search.pixel(iqx >> 2, iqy >> 2,
+                                                      iqx & 3, iqy & 3),
+                                         search.stride(), size,
+                                         integer_bound(bound), rows);
+    count_bounded(size, rows);
+    return(sad);
+  }
+
+  return(SAD_bounded(ref, search.image(), rx, ry, sx, sy, size, bound));
+}
+
+// Bounded block distortion metric with interpolated search image at
+// quarter pixel co-ordinates
+float SAD_qpel_bounded(const cv::Mat &ref, const InterpolatedReference &search,
+                       int rx, int ry, int qx, int qy, int size, float bound)
+{
+  int sx = qx >> MV_FRAC_BITS;
+  int sy = qy >> MV_FRAC_BITS;
+
+  if(search.contains(sx, sy, size, size))
+  {
+    int rows;
+    unsigned int sad = sad_block_bounded(ref.ptr<unsigned char>(ry) + rx, ref.step,
+                                         search.pixel(sx, sy, qx & (MV_UNIT-1),
+                                                      qy & (MV_UNIT-1)),
+                                         search.stride(), size,
+                                         integer_bound(bound), rows);
+    count_bounded(size, rows);
+    return(sad);
+  }
+
+  return(SAD_bounded(ref, search.image(), rx, ry, qx*(1.0f/MV_UNIT),
+                     qy*(1.0f/MV_UNIT), size, bound));
+}
+
+// Bounded block distortion metric at integer position
+int SAD_integer_bounded(const cv::Mat &ref, const cv::Mat &search,
+                        int rx, int ry, int sx, int sy, int size, int bound)
+{
+  int rows;
+  unsigned int sad = sad_block_bounded(ref.ptr<unsigned char>(ry) + rx, ref.step,
+                                       search.ptr<unsigned char>(sy) + sx,
+                                       search.step, size,
+                                       (bound < 0) ? 0 : bound, rows);
+  count_bounded(size, rows);
+
+  return((int)(sad));
+}
+
+// Bounded integer block distortion metric for a fixed block size
+template<int N>
+int SAD_integer_bounded(const cv::Mat &ref, const cv::Mat &search,
+                        int rx, int ry, int sx, int sy, int bound)
+{
+  static const sad_fn kernel = sad_bounded_kernel(N);
+
+  int rows;
+  unsigned int sad = kernel(ref.ptr<unsigned char>(ry) + rx, ref.step,
+                            search.ptr<unsigned char>(sy) + sx, search.step,
+                            N, (bound < 0) ? 0 : bound, rows);
+  count_bounded(N, rows);
+
+  return((int)(sad));
+}
+
+template int SAD_integer_bounded<4>(const cv::Mat &, const cv::Mat &,
+                                    int, int, int, int, int);
+template int SAD_integer_bounded<8>(const cv::Mat &, const cv::Mat &,
+                                    int, int, int, int, int);
+template int SAD_integer_bounded<16>(const cv::Mat &, const cv::Mat &,
+                                     int, int, int, int, int);
+template int SAD_integer_bounded<32>(const cv::Mat &, const cv::Mat &,
+                                     int, int, int, int, int);
+template int SAD_integer_bounded<64>(const cv::Mat &, const cv::Mat &,
+                                     int, int, int, int, int);
+
+// Turn early termination counters on or off
+void enable_sad_counters(bool enable)
+{
+  counting = enable;
+}
+
+// Get early termination counters
+SADCounters sad_counters()
+{
+  std::lock_guard<std::mutex> lock(counters_mutex);
+
+  SADCounters total = finished_counters;
+
+  for(const ThreadSADCounters *c : counters_list)
+  {
+    total.calls        += c->calls;
+    total.terminated   += c->terminated;
+    total.rows         += c->rows;
+    total.rows_skipped += c->rows_skipped;
+  }
+
+  return(total);
+}
+
+// Reset early termination counters
+void reset_sad_counters()
+{
+  std::lock_guard<std::mutex> lock(counters_mutex);
+
+  finished_counters = SADCounters();
+
+  for(ThreadSADCounters *c : counters_list)
+  {
+    c->calls = 0; c->terminated = 0; c->rows = 0; c->rows_skipped = 0;
+  }
+}
+
 // Save motion vectors
 bool save_vectors(const std::vector<cv::Vec2f> &mv,
                   const std::string &output_filename)
@@ -110,17 +380,10 @@ bool save_vectors(const std::vector<cv::Vec2f> &mv,
 }
 
 // Load motion vectors
-bool load_vectors(const std::string &mv_filename, std::vector<cv::Vec2f> &mv)
+bool load_vectors(const std::string &mv_filename, MotionField &mv)
 {
-  std::ifstream input(mv_filename, std::ios_base::binary);
-  if(!input) return(false);
+  MVReader reader;
+  if(!reader.open(mv_filename) || (reader.frames() < 1)) return(false);
 
-  while(true)
-  {
-    cv::Vec2f vec;
-    if(!input.read(reinterpret_cast<char *>(&vec), sizeof(cv::Vec2f))) break;
-    mv.push_back(vec);
-  }
-
-  return(true);
+  return(reader.field(0, mv));
 }
@@ -12,9 +12,27 @@
 #include <string>
 #include <opencv2/core.hpp>
 
+#include "interpolatedref.h"
+#include "bilinear.h"
+#include "motionvector.h"
+
+
+/// Counters for SAD early termination, totalled over all threads
+struct SADCounters
+{
+  long long calls        = 0;   ///< bounded SAD calls
+  long long terminated   = 0;   ///< calls that stopped early
+  long long rows         = 0;   ///< rows in all calls
+  long long rows_skipped = 0;   ///< rows not summed due to early termination
+};
+
 
 /**
- * Interpolate pixel using bilinear interpolation
+ * Interpolate pixel using bilinear interpolation. The co-ordinates are
+ * rounded to 1/BILINEAR_ONE pixel and interpolated in fixed point by
+ * interpolate_fixed(); for quarter pixel co-ordinates this is exact, and
+ * elsewhere it is within 1 of rounding the floating point blend of the
+ * exact co-ordinates. Pixels off the image are zero.
  * @param img       input image; must be single channel uchar, i.e. CV_8U or CV_8UC1
  * @param fx        x co-ordinate to interpolate
  * @param fy        y co-ordinate to interpolate
@@ -26,7 +44,9 @@ unsigned char interpolate(const cv::Mat &img, float fx, float fy);
  * SAD (sum of absolute differences)
  * Calculate block distortion metric for block in reference
  * image at integer co-ordinates with block in search image
- * at floating point co-ordinates
+ * at floating point co-ordinates. Blocks at quarter pixel co-ordinates up
+ * to BILINEAR_STRIP wide are interpolated with interpolate_block(), others
+ * a pixel at a time with interpolate().
  * @param ref       reference image (luminance)
  * @param search    search image (luminance)
  * @param rx        origin of ref image block
@@ -40,7 +60,157 @@ float SAD(const cv::Mat &ref, const cv::Mat &search,
           int rx, int ry, float sx, float sy, int size);
 
 /**
- * Save motion vectors
+ * SAD (sum of absolute differences) with interpolated search image
+ * As SAD() but blocks at quarter pixel co-ordinates are read from the
+ * precomputed phase planes; other positions fall back to interpolate().
+ * @param ref       reference image (luminance)
+ * @param search    interpolated search image (luminance)
+ * @param rx        origin of ref image block
+ * @param ry        origin of ref image block
+ * @param sx        origin of search image block
+ * @param sy        origin of search image block
+ * @param size      block size
+ * @return SAD for block
+ */
+float SAD(const cv::Mat &ref, const InterpolatedReference &search,
+          int rx, int ry, float sx, float sy, int size);
+
+/**
+ * Integer SAD (sum of absolute differences)
+ * Calculate block distortion metric for blocks at integer co-ordinates in
+ * both images using the SIMD kernels; the search block must lie within the
+ * search image. Gives the same result as SAD() at integer co-ordinates.
+ * @param ref       reference image (luminance)
+ * @param search    search image (luminance)
+ * @param rx        origin of ref image block
+ * @param ry        origin of ref image block
+ * @param sx        origin of search image block
+ * @param sy        origin of search image block
+ * @param size      block size
+ * @return SAD for block
+ */
+int SAD_integer(const cv::Mat &ref, const cv::Mat &search,
+                int rx, int ry, int sx, int sy, int size);
+
+/**
+ * Bounded SAD
+ * As SAD() but stops summing, every SAD_ROW_GROUP rows for quarter pixel
+ * positions or every row for others, once the running sum is greater than
+ * the bound, e.g. the caller's best BDM so
+ * far. Any result not greater than the bound is the exact SAD, so a search
+ * that only accepts candidates at or below its best gives the same result.
+ * @param ref       reference image (luminance)
+ * @param search    search image (luminance)
+ * @param rx        origin of ref image block
+ * @param ry        origin of ref image block
+ * @param sx        origin of search image block
+ * @param sy        origin of search image block
+ * @param size      block size
+ * @param bound     stop when the running sum is greater than this
+ * @return SAD for block, or a partial SAD greater than bound
+ */
+float SAD_bounded(const cv::Mat &ref, const cv::Mat &search,
+                  int rx, int ry, float sx, float sy, int size, float bound);
+
+/**
+ * Bounded SAD with interpolated search image; see SAD_bounded() above
+ * @param ref       reference image (luminance)
+ * @param search    interpolated search image (luminance)
+ * @param rx        origin of ref image block
+ * @param ry        origin of ref image block
+ * @param sx        origin of search image block
+ * @param sy        origin of search image block
+ * @param size      block size
+ * @param bound     stop when the running sum is greater than this
+ * @return SAD for block, or a partial SAD greater than bound
+ */
+float SAD_bounded(const cv::Mat &ref, const InterpolatedReference &search,
+                  int rx, int ry, float sx, float sy, int size, float bound);
+
+/**
+ * Bounded SAD with interpolated search image at fixed point co-ordinates;
+ * gives the same result as SAD_bounded() above at sx = qx/MV_UNIT,
+ * sy = qy/MV_UNIT without any floating point addressing
+ * @param ref       reference image (luminance)
+ * @param search    interpolated search image (luminance)
+ * @param rx        origin of ref image block
+ * @param ry        origin of ref image block
+ * @param qx        origin of search image block in quarter pixels
+ * @param qy        origin of search image block in quarter pixels
+ * @param size      block size
+ * @param bound     stop when the running sum is greater than this
+ * @return SAD for block, or a partial SAD greater than bound
+ */
+float SAD_qpel_bounded(const cv::Mat &ref, const InterpolatedReference &search,
+                       int rx, int ry, int qx, int qy, int size, float bound);
+
+/**
+ * Bounded integer SAD; see SAD_bounded() above
+ * @param ref       reference image (luminance)
+ * @param search    search image (luminance)
+ * @param rx        origin of ref image block
+ * @param ry        origin of ref image block
+ * @param sx        origin of search image block
+ * @param sy        origin of search image block
+ * @param size      block size
+ * @param bound     stop when the running sum is greater than this
+ * @return SAD for block, or a partial SAD greater than bound
+ */
+int SAD_integer_bounded(const cv::Mat &ref, const cv::Mat &search,
+                        int rx, int ry, int sx, int sy, int size, int bound);
+
+/**
+ * Bounded integer SAD for a block size fixed at compile time; as above but
+ * the kernel is looked up once rather than on every call. Instantiated for
+ * block sizes 4, 8, 16, 32 and 64.
+ * @param ref       reference image (luminance)
+ * @param search    search image (luminance)
+ * @param rx        origin of ref image block
+ * @param ry        origin of ref image block
+ * @param sx        origin of search image block
+ * @param sy        origin of search image block
+ * @param bound     stop when the running sum is greater than this
+ * @return SAD for block, or a partial SAD greater than bound
+ */
+template<int N>
+int SAD_integer_bounded(const cv::Mat &ref, const cv::Mat &search,
+                        int rx, int ry, int sx, int sy, int bound);
+
+extern template int SAD_integer_bounded<4>(const cv::Mat &, const cv::Mat &,
+                                           int, int, int, int, int);
+extern template int SAD_integer_bounded<8>(const cv::Mat &, const cv::Mat &,
+                                           int, int, int, int, int);
+extern template int SAD_integer_bounded<16>(const cv::Mat &, const cv::Mat &,
+                                            int, int, int, int, int);
+extern template int SAD_integer_bounded<32>(const cv::Mat &, const cv::Mat &,
+                                            int, int, int, int, int);
+extern template int SAD_integer_bounded<64>(const cv::Mat &, const cv::Mat &,
+                                            int, int, int, int, int);
+
+/**
+ * Turn counting of bounded SAD calls on or off; off by default as counting
+ * costs a little on the smallest blocks. Call when no block matching is
+ * running.
+ * @param enable    true to count
+ */
+void enable_sad_counters(bool enable);
+
+/**
+ * Get early termination counters of bounded SAD calls, totalled over all
+ * threads. Call when no block matching is running.
+ * @return counters
+ */
+SADCounters sad_counters();
+
+/**
+ * Reset early termination counters of all threads to zero.
+ * Call when no block matching is running.
+ */
+void reset_sad_counters();
+
+/**
+ * Save motion vectors as a legacy raw blob without a header; see mvfile.h
+ * for the self-describing format
  * @param mv                 the motion vectors to save
  * @param output_filename    name of file to save vectors to
  * @return true if success
@@ -49,13 +219,13 @@ bool save_vectors(const std::vector<cv::Vec2f> &mv,
                   const std::string &output_filename);
 
 /**
- * Load motion vectors
+ * Load motion vectors of the first field of a motion vector file or of a
+ * legacy raw blob, converting them to quarter pixels if necessary
  * @param mv_filename        name of the motion vectors file to load
  * @param mv                 the loaded motion vectors
  * @return true if success
  */
-bool load_vectors(const std::string &mv_filename,
-                  std::vector<cv::Vec2f> &mv);
+bool load_vectors(const std::string &mv_filename, MotionField &mv);
 
 #endif    // bmsupport_h
 
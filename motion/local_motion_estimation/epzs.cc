@@ -0,0 +1,122 @@
+/**
+ * @file   epzs.cc
+ * @brief  Block Matching Algorithm: EPZS
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#include "epzs.h"
+#include "fullsearch.h"
+#include "bmsupport.h"
+#include "staticblocks.h"
+
+
+// Estimate motion of one block; the left, top and top right blocks must
+// already have been estimated
+static void epzs_block(const cv::Mat &current, const cv::Mat &previous,
+                       int bx, int by, int blk_size,
+                       const MotionField *previous_field,
+                       PredictiveWorkspace &workspace, MotionField &mv,
+                       BlockStats *stats)
+{
+  int blocks_wide = current.cols/blk_size;
+  int blocks_high = current.rows/blk_size;
+  int index = by*blocks_wide + bx;
+  int area  = blk_size*blk_size;
+
+  BlockSearch search(current, previous, bx*blk_size, by*blk_size, blk_size,
+                     RANGE);
+
+  BlockExit    exit    = EXIT_MEDIAN;
+  BlockPattern pattern = PATTERN_NONE;
+
+  // 1. Median predictor; stop if below T1
+
+  search.check(median_predictor(mv, bx, by, blocks_wide));
+
+  if(search.best_sad() >= area)
+  {
+    // 2. Zero, spatial and temporal predictors
+
+    search.check(0, 0);
+
+    if(bx > 0) search.check(mv[index-1]);
+    if(by > 0) {
+      search.check(mv[index-blocks_wide]);
+      if(bx < blocks_wide-1) search.check(mv[index-blocks_wide+1]);
+    }
+
+    if(previous_field)
+    {
+      search.check((*previous_field)[index]);
+      if(bx < blocks_wide-1) search.check((*previous_field)[index+1]);
+      if(by < blocks_high-1) search.check((*previous_field)[index+blocks_wide]);
+    }
+
+    // 3. Stop if as good as the neighbours are expected to be, else refine
+
+    int predicted = neighbour_sad(workspace.sad, bx, by, blocks_wide);
+    int T2 = (predicted == INT_MAX) ? area : predicted*6/5 + area/2;
+
+    exit = EXIT_PREDICTOR;
+
+    if(search.best_sad() >= T2)
+    {
+      diamond_refine(search);
+      exit    = EXIT_SEARCH;
+      pattern = PATTERN_SMALL;
+    }
+  }
+
+  mv[index] = search.best();
+  workspace.sad[index] = search.best_sad();
+
+  if(stats) set_block_stats(search, exit, pattern, *stats);
+}
+
+// EPZS
+MotionField epzs(const cv::Mat &current, const cv::Mat &previous,
+                 int blk_size, const MotionField *previous_field)
+{
+  PredictiveWorkspace workspace;
+  MotionField mv;
+  epzs(current, previous, blk_size, nullptr, previous_field, workspace, mv);
+  return(mv);
+}
+
+// EPZS with workspace; serial if pool is null, otherwise a wavefront
+void epzs(const cv::Mat &current, const cv::Mat &previous, int blk_size,
+          ThreadPool *pool, const MotionField *previous_field,
+          PredictiveWorkspace &workspace, MotionField &mv,
+          BlockStatsField *block_stats, const SkipMap *skip)
+{
+  int blocks_wide = current.cols/blk_size;
+  int blocks_high = current.rows/blk_size;
+
+  mv.resize(blocks_wide*blocks_high);
+  workspace.sad.resize(mv.size());
+  if(block_stats) block_stats->resize(mv.size());
+
+  if(previous_field && (previous_field->size() != mv.size()))
+    previous_field = nullptr;
+
+  auto process_block = [&](int bx, int by)
+  {
+    int index = by*blocks_wide + bx;
+
+    if(is_static(skip, index))
+    {
+      static_block(current, previous, bx, by, blk_size, blocks_wide,
+                   workspace.sad, mv,
+                   block_stats ? &(*block_stats)[index] : nullptr);
+      return;
+    }
+
+    epzs_block(current, previous, bx, by, blk_size, previous_field,
+               workspace, mv,
+               block_stats ? &(*block_stats)[index] : nullptr);
+  };
+
+  run_wavefront(blocks_wide, blocks_high, pool, workspace.wavefront,
+                process_block);
+}
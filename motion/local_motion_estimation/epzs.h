@@ -0,0 +1,67 @@
+/**
+ * @file   epzs.h
+ * @brief  Block Matching Algorithm: EPZS
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#ifndef epzs_h
+#define epzs_h
+
+#include <opencv2/core.hpp>
+
+#include "threadpool.h"
+#include "blocksearch.h"
+#include "motionvector.h"
+
+
+/**
+ * epzs
+ * @brief Enhanced Predictive Zonal Search,
+ *        "Enhanced Predictive Zonal Search for Single and Multiple Frame
+ *        Motion Estimation", 2002, A.M. Tourapis, Proceedings of SPIE VCIP,
+ *        doi 10.1117/12.453031
+ *        The median predictor is checked first and the search stops if its
+ *        SAD is below T1. Otherwise the zero vector, the left, top and top
+ *        right vectors and, in a sequence, the co-located vector of the
+ *        previous field and those right of and below it are checked; the
+ *        search stops if the best is below T2, 1.2 times the least SAD of
+ *        the neighbouring blocks plus an offset, else a small diamond
+ *        refines it. T1 = 256 and the offset 128 for 16x16 blocks and are
+ *        scaled by area. Runs as a wavefront with a pool; vectors are the
+ *        same. Vectors are limited to +/-RANGE.
+ * @param current          current image
+ * @param previous         previous image
+ * @param blk_size         block size
+ * @param previous_field   whole pixel vectors of the previous frame with the
+ *                         same block size, or null for spatial predictors
+ *                         only
+ * @return  motion vectors
+ */
+MotionField epzs(const cv::Mat &current, const cv::Mat &previous,
+                 int blk_size, const MotionField *previous_field = nullptr);
+
+/**
+ * epzs
+ * @brief As above using a workspace and writing into an existing field, so
+ *        that nothing is allocated from frame to frame
+ * @param current          current image
+ * @param previous         previous image
+ * @param blk_size         block size
+ * @param pool             threads to run the wavefront on, or null to run
+ *                         serially
+ * @param previous_field   vectors of the previous frame, or null
+ * @param workspace        wavefront progress and SADs of each block
+ * @param mv               motion vectors
+ * @param block_stats      if not null, set to the SADs, pattern steps,
+ *                         exit and pattern of each block
+ * @param skip             if not null, static blocks are given a zero vector
+ *                         without a search
+ */
+void epzs(const cv::Mat &current, const cv::Mat &previous, int blk_size,
+          ThreadPool *pool, const MotionField *previous_field,
+          PredictiveWorkspace &workspace, MotionField &mv,
+          BlockStatsField *block_stats = nullptr,
+          const SkipMap *skip = nullptr);
+
+#endif    // epzs_h
@@ -0,0 +1,441 @@
+/**
+ * @file   estimate.cc
+ * @brief  Run a chosen block matching algorithm
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#include "estimate.h"
+#include "hexagon.h"
+#include "epzs.h"
+#include "umhexagons.h"
+#include "subpixel.h"
+
+
+// 2D Full Search
+class FullSearchStrategy : public SearchStrategy
+{
+public:
+  FullSearchStrategy(const EstimateSettings &settings, ThreadPool *pool)
+    : blocksize_(settings.blocksize), range_(settings.range), pool_(pool) {}
+
+  void search(PreparedFrame &current, PreparedFrame &previous,
+              const MotionField *, MotionField &mv, EstimateStats &,
+              BlockStatsField *,
+              const SkipMap *skip, const RangeMap *ranges,
+              const MotionVector *global) override
+  {
+    fullsearch(current.image(), previous.image(), blocksize_, pool_, mv, skip,
+               range_, ranges, global ? *global : MotionVector(0, 0));
+  }
+
+private:
+  int         blocksize_, range_;
+  ThreadPool *pool_;
+};
+
+// 2D Full Search with successive elimination
+class SEAStrategy : public SearchStrategy
+{
+public:
+  SEAStrategy(const EstimateSettings &settings, ThreadPool *pool)
+    : blocksize_(settings.blocksize), range_(settings.range), pool_(pool) {}
+
+  void search(PreparedFrame &current, PreparedFrame &previous,
+              const MotionField *, MotionField &mv, EstimateStats &stats,
+              BlockStatsField *,
+              const SkipMap *skip, const RangeMap *ranges,
+              const MotionVector *global) override
+  {
+    // Sub-block sums are kept with each frame
+
+    fullsearch_sea(current.image(), previous.image(), blocksize_, pool_,
+                   current.sea_planes(blocksize_),
+                   previous.sea_planes(blocksize_), workspace_, mv, &stats.sea,
+                   skip, range_, ranges, global ? *global : MotionVector(0, 0));
+  }
+
+private:
+  int          blocksize_, range_;
+  ThreadPool  *pool_;
+  SEAWorkspace workspace_;
+};
+
+// PMVFAST
+class PMVFASTStrategy : public SearchStrategy
+{
+public:
+  PMVFASTStrategy(const EstimateSettings &settings, ThreadPool *pool)
+    : blocksize_(settings.blocksize), pool_(pool) {}
+
+  void search(PreparedFrame &current, PreparedFrame &previous,
+              const MotionField *previous_field, MotionField &mv,
+              EstimateStats &stats, BlockStatsField *block_stats,
+              const SkipMap *skip, const RangeMap *,
+              const MotionVector *global) override
+  {
+    pmvfast(current.image(), previous.image(), blocksize_, pool_,
+            previous_field, workspace_, mv, &stats.pmvfast, block_stats, skip,
+            global);
+  }
+
+private:
+  int              blocksize_;
+  ThreadPool      *pool_;
+  PMVFASTWorkspace workspace_;
+};
+
+// Hierarchical search
+class HierarchicalStrategy : public SearchStrategy
+{
+public:
+  HierarchicalStrategy(const EstimateSettings &settings, ThreadPool *pool)
+    : blocksize_(settings.blocksize), levels_(settings.levels), pool_(pool) {}
+
+  void search(PreparedFrame &current, PreparedFrame &previous,
+              const MotionField *, MotionField &mv, EstimateStats &,
+              BlockStatsField *,
+              const SkipMap *skip, const RangeMap *,
+              const MotionVector *) override
+  {
+    // Pyramids are kept with each frame
+
+    int levels = hierarchical_levels(blocksize_, levels_);
+
+    hierarchical_search(current.pyramid(levels), previous.pyramid(levels),
+                        blocksize_, levels, pool_, mv, skip);
+  }
+
+private:
+  int                   blocksize_, levels_;
+  ThreadPool           *pool_;
+};
+
+// Hexagon-based search
+class HexagonStrategy : public SearchStrategy
+{
+public:
+  HexagonStrategy(const EstimateSettings &settings, ThreadPool *pool)
+    : blocksize_(settings.blocksize), pool_(pool) {}
+
+  void search(PreparedFrame &current, PreparedFrame &previous,
+              const MotionField *, MotionField &mv, EstimateStats &,
+              BlockStatsField *block_stats,
+              const SkipMap *skip, const RangeMap *,
+              const MotionVector *) override
+  {
+    hexagon_search(current.image(), previous.image(), blocksize_, pool_, mv,
+                   block_stats, skip);
+  }
+
+private:
+  int         blocksize_;
+  ThreadPool *pool_;
+};
+
+// EPZS
+class EPZSStrategy : public SearchStrategy
+{
+public:
+  EPZSStrategy(const EstimateSettings &settings, ThreadPool *pool)
+    : blocksize_(settings.blocksize), pool_(pool) {}
+
+  void search(PreparedFrame &current, PreparedFrame &previous,
+              const MotionField *previous_field, MotionField &mv,
+              EstimateStats &, BlockStatsField *block_stats,
+              const SkipMap *skip, const RangeMap *,
+              const MotionVector *) override
+  {
+    epzs(current.image(), previous.image(), blocksize_, pool_, previous_field,
+         workspace_, mv, block_stats, skip);
+  }
+
+private:
+  int                 blocksize_;
+  ThreadPool         *pool_;
+  PredictiveWorkspace workspace_;
+};
+
+// UMHexagonS
+class UMHexagonSStrategy : public SearchStrategy
+{
+public:
+  UMHexagonSStrategy(const EstimateSettings &settings, ThreadPool *pool)
+    : blocksize_(settings.blocksize), pool_(pool) {}
+
+  void search(PreparedFrame &current, PreparedFrame &previous,
+              const MotionField *previous_field, MotionField &mv,
+              EstimateStats &, BlockStatsField *block_stats,
+              const SkipMap *skip, const RangeMap *,
+              const MotionVector *) override
+  {
+    umhexagons(current.image(), previous.image(), blocksize_, pool_,
+               previous_field, workspace_, mv, block_stats, skip);
+  }
+
+private:
+  int                 blocksize_;
+  ThreadPool         *pool_;
+  PredictiveWorkspace workspace_;
+};
+
+// Factory for a strategy class
+template<class Strategy>
+static std::unique_ptr<SearchStrategy> make_strategy(const EstimateSettings &settings,
+                                                     ThreadPool *pool)
+{
+  return(std::make_unique<Strategy>(settings, pool));
+}
+
+// Registered strategies, starting with the built in ones
+static std::vector<StrategyInfo> &registry()
+{
+  static std::vector<StrategyInfo> entries = {
+    { "2dfs",         "full search; best vectors in range, slowest",
+      make_strategy<FullSearchStrategy>, true, true, true },
+    { "sea",          "full search with successive elimination",
+      make_strategy<SEAStrategy>, true, true },
+    { "pmvfast",      "predictive diamond search",
+      make_strategy<PMVFASTStrategy>, false, true },
+    { "hierarchical", "full search of a pyramid, refined per level",
+      make_strategy<HierarchicalStrategy> },
+    { "hexagon",      "hexagon-based search from zero vector",
+      make_strategy<HexagonStrategy> },
+    { "epzs",         "enhanced predictive zonal search",
+      make_strategy<EPZSStrategy> },
+    { "umhexagons",   "unsymmetrical cross multi-hexagon search",
+      make_strategy<UMHexagonSStrategy> } };
+
+  return(entries);
+}
+
+// Add a search strategy
+bool register_strategy(const StrategyInfo &info)
+{
+  if(find_strategy(info.name)) return(false);
+
+  registry().push_back(info);
+  return(true);
+}
+
+// Find a search strategy by name
+const StrategyInfo *find_strategy(const std::string &name)
+{
+  for(const StrategyInfo &info : registry())
+    if(info.name == name) return(&info);
+
+  return(nullptr);
+}
+
+// All search strategies
+const std::vector<StrategyInfo> &strategies()
+{
+  return(registry());
+}
+
+MotionEstimator::MotionEstimator(const EstimateSettings &settings,
+                                 ThreadPool *pool)
+  : settings_(settings), pool_(pool), interpolated_(&reference_),
+    block_stats_enabled_(false)
+{
+  const StrategyInfo *info = find_strategy(settings.algorithm);
+
+  if(info) strategy_ = info->create(settings, pool);
+
+  uses_multisize_ = info && info->uses_multisize;
+  uses_range_     = info && info->uses_range;
+  uses_global_    = info && info->uses_global;
+}
+
+// Estimate integer motion vectors
+const MotionField &MotionEstimator::estimate(const cv::Mat &current_img,
+                                             const cv::Mat &previous_img,
+                                             const MotionField *previous_field)
+{
+  // The frames share the images, so only their derived data is rebuilt
+
+  current_frame_.set(current_img);
+  previous_frame_.set(previous_img);
+
+  return(estimate(current_frame_, previous_frame_, previous_field));
+}
+
+// Estimate integer motion vectors between prepared frames
+const MotionField &MotionEstimator::estimate(PreparedFrame &current,
+                                             PreparedFrame &previous,
+                                             const MotionField *previous_field)
+{
+  const cv::Mat &current_img  = current.image();
+  const cv::Mat &previous_img = previous.image();
+
+  if(!valid())
+  {
+    field_.clear();
+    smaller_.clear();
+    smaller_skip_.clear();
+    skip_.clear();
+    return(field_);
+  }
+
+  BlockStatsField *block_stats = block_stats_enabled_ ? &block_stats_ : nullptr;
+
+  // Algorithms without block counters leave them at zero
+
+  if(block_stats) block_stats->clear();
+
+  const SkipMap *skip = nullptr;
+  const RangeMap *ranges = nullptr;
+
+  if(settings_.static_threshold >= 0)
+  {
+    stats_.static_blocks += static_blocks(current_img, previous_img,
+                                          settings_.blocksize,
+                                          settings_.static_threshold, pool_,
+                                          skip_);
+    skip = &skip_;
+  }
+  else
+    skip_.clear();
+
+  // Adaptive ranges are from the last frame, so only if it was the same size
+
+  int blocks_wide = current_img.cols/settings_.blocksize;
+  int blocks_high = current_img.rows/settings_.blocksize;
+
+  bool adaptive = settings_.adaptive_range && uses_range_;
+
+  if(adaptive && (ranges_.size() == (size_t)blocks_wide*blocks_high))
+    ranges = &ranges_;
+
+  const MotionVector *global = nullptr;
+
+  if((settings_.global_motion != GLOBAL_NONE) && uses_global_)
+  {
+    ::global_motion(current_img, previous_img, settings_.global_motion,
+                    global_workspace_, global_);
+    global = &global_;
+  }
+  else
+    global_ = MotionVector(0, 0);
+
+  // Full search at several sizes replaces the strategy
+
+  if(uses_multisize_ &&
+     multisize_supported(settings_.min_blocksize, settings_.blocksize))
+  {
+    multisize_search(current_img, previous_img, settings_.min_blocksize,
+                     settings_.blocksize, pool_, multisize_, field_, smaller_,
+                     skip, settings_.range, ranges, global_);
+
+    // Sub-blocks of static blocks were given zero vectors too
+
+    smaller_skip_.resize(skip ? smaller_.size() : 0);
+
+    for(size_t i = 0; i < smaller_skip_.size(); i++)
+      subdivide_skip_map(skip_, blocks_wide,
+                         settings_.blocksize/(settings_.min_blocksize << i),
+                         smaller_skip_[i]);
+  }
+  else
+  {
+    smaller_.clear();
+    smaller_skip_.clear();
+    strategy_->search(current, previous, previous_field, field_, stats_,
+                      block_stats, skip, ranges, global);
+  }
+
+  if(adaptive)
+  {
+    for(size_t i = 0; i < field_.size(); i++)
+    {
+      if(is_static(skip, (int)i)) continue;
+
+      stats_.range_blocks++;
+      stats_.range_total += block_range(ranges, (int)i, settings_.range);
+    }
+
+    adaptive_ranges(field_, blocks_wide, settings_.range,
+                    settings_.range_margin, settings_.range_region, ranges,
+                    range_workspace_, ranges_, global_);
+  }
+
+  if(block_stats)
+  {
+    block_stats->resize(field_.size());
+
+    // Also for the algorithms without block counters
+
+    if(skip)
+    {
+      for(size_t i = 0; i < skip_.size(); i++)
+        if(skip_[i]) (*block_stats)[i].exit = EXIT_STATIC;
+    }
+  }
+
+  return(field_);
+}
+
+// Build quarter pixel planes
+const InterpolatedReference &MotionEstimator::interpolate(const cv::Mat &previous_img)
+{
+  reference_.build(previous_img);
+  interpolated_ = &reference_;
+  return(reference_);
+}
+
+// Use the quarter pixel planes of a prepared frame
+const InterpolatedReference &MotionEstimator::interpolate(PreparedFrame &previous)
+{
+  interpolated_ = &previous.reference();
+  return(*interpolated_);
+}
+
+// Subpixel refinement
+const MotionField &MotionEstimator::refine(const cv::Mat &current_img)
+{
+  if(!valid()) return(field_);
+
+  subpixel_search(current_img, *interpolated_, settings_.blocksize, field_,
+                  block_stats_enabled_ ? &block_stats_ : nullptr,
+                  skip_.empty() ? nullptr : &skip_, settings_.subpixel);
+
+  for(size_t i = 0; i < smaller_.size(); i++)
+    subpixel_search(current_img, *interpolated_, settings_.min_blocksize << i,
+                    smaller_[i], nullptr,
+                    smaller_skip_.empty() ? nullptr : &smaller_skip_[i],
+                    settings_.subpixel);
+
+  return(field_);
+}
+
+// Reset statistics
+void MotionEstimator::reset_stats()
+{
+  stats_ = EstimateStats();
+}
+
+// Run block matching algorithm; serially if pool is null
+MotionField estimate(const cv::Mat &current_img, const cv::Mat &previous_img,
+                     const EstimateSettings &settings, ThreadPool *pool,
+                     const MotionField *previous_field, SEAStats *sea_stats,
+                     PMVFASTStats *pmvfast_stats)
+{
+  MotionEstimator estimator(settings, pool);
+  MotionField mv = estimator.estimate(current_img, previous_img,
+                                      previous_field);
+
+  if(sea_stats)
+  {
+    sea_stats->candidates += estimator.sea_stats().candidates;
+    sea_stats->eliminated += estimator.sea_stats().eliminated;
+  }
+
+  if(pmvfast_stats)
+  {
+    pmvfast_stats->blocks         += estimator.pmvfast_stats().blocks;
+    pmvfast_stats->median_stops   += estimator.pmvfast_stats().median_stops;
+    pmvfast_stats->temporal_stops += estimator.pmvfast_stats().temporal_stops;
+  }
+
+  return(mv);
+}
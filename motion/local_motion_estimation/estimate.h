@@ -0,0 +1,351 @@
+/**
+ * @file   estimate.h
+ * @brief  Run a chosen block matching algorithm
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#ifndef estimate_h
+#define estimate_h
+
+#include <vector>
+#include <string>
+#include <memory>
+
+#include <opencv2/core.hpp>
+
+#include "fullsearch.h"
+#include "pmvfast.h"
+#include "hierarchical.h"
+#include "multisize.h"
+#include "interpolatedref.h"
+#include "blockstats.h"
+#include "staticblocks.h"
+#include "searchrange.h"
+#include "globalmotion.h"
+#include "framecache.h"
+#include "subpixel.h"
+#include "threadpool.h"
+#include "motionvector.h"
+
+/// Settings for estimating motion between a pair of frames
+struct EstimateSettings
+{
+  int         blocksize = 16;
+  std::string algorithm = "2dfs";        ///< name of a registered strategy
+  int         levels    = HIER_LEVELS;   ///< hierarchical pyramid levels
+
+  /// Search range in pixels of 2dfs and sea; the largest range if it is
+  /// adaptive
+  int         range = RANGE;
+
+  /// Size the search range of 2dfs and sea for each frame from the vectors
+  /// of the frame before; see adaptive_ranges(). Ignored by algorithms
+  /// without StrategyInfo::uses_range.
+  bool        adaptive_range = false;
+  int         range_margin   = RANGE_MARGIN;  ///< pixels added to percentile
+  int         range_region   = 0;    ///< region size in blocks; 0 for frame
+
+  /// Estimate the global translation of each frame first; 2dfs, sea and
+  /// multi-size search also search a window centred on it and PMVFAST adds
+  /// it to its predictors. Not estimated for algorithms without
+  /// StrategyInfo::uses_global.
+  GlobalMotionMethod global_motion = GLOBAL_NONE;
+
+  /// Greatest mean absolute difference per pixel between a block and the
+  /// same block of the previous frame for the block to be static, given a
+  /// zero vector and not searched; negative to search every block
+  float       static_threshold = -1.0f;
+
+  /// If not 0, algorithms with StrategyInfo::uses_multisize also give
+  /// fields at each smaller power of two block size down to this one, from
+  /// the same pass of SADs; see multisize_search()
+  int         min_blocksize = 0;
+
+  /// How refine() refines integer vectors to quarter pixels
+  SubpixelMode subpixel = SUBPIXEL_FULL;
+};
+
+/// Statistics of the algorithms that report them
+struct EstimateStats
+{
+  SEAStats     sea;
+  PMVFASTStats pmvfast;
+  long long    static_blocks = 0;       ///< blocks not searched as static
+  long long    range_blocks  = 0;       ///< blocks given an adaptive range
+  long long    range_total   = 0;       ///< sum of their ranges
+};
+
+
+/**
+ * SearchStrategy
+ * @brief A block matching algorithm as run by MotionEstimator. Each
+ *        estimator makes its own instance, which keeps whatever buffers the
+ *        algorithm needs from frame to frame.
+ */
+class SearchStrategy
+{
+public:
+  virtual ~SearchStrategy() = default;
+
+  /**
+   * Estimate integer motion vectors
+   * @param current          current frame
+   * @param previous         previous frame, the reference searched
+   * @param previous_field   previous frame's integer vectors for temporal
+   *                         predictors, or null; may be ignored
+   * @param mv               motion vectors, resized as necessary
+   * @param stats            statistics to add to, if the algorithm has any
+   * @param block_stats      if not null, per block counters to set, if the
+   *                         algorithm has any; null unless asked for, so
+   *                         counting costs nothing otherwise
+   * @param skip             if not null, static blocks, which must be given
+   *                         a zero vector without a search
+   * @param ranges           if not null, the search range of each block in
+   *                         place of the one in the settings; may be
+   *                         ignored
+   * @param global           if not null, the global motion of the frame in
+   *                         whole pixels, to centre windows on or predict
+   *                         from; may be ignored
+   */
+  virtual void search(PreparedFrame &current, PreparedFrame &previous,
+                      const MotionField *previous_field, MotionField &mv,
+                      EstimateStats &stats, BlockStatsField *block_stats,
+                      const SkipMap *skip, const RangeMap *ranges,
+                      const MotionVector *global) = 0;
+};
+
+/// Make a strategy for the given settings and pool, which may be null
+typedef std::unique_ptr<SearchStrategy> (*StrategyFactory)
+  (const EstimateSettings &settings, ThreadPool *pool);
+
+/// Registered search strategy
+struct StrategyInfo
+{
+  std::string     name;          ///< name given to -a
+  std::string     description;   ///< one line for usage messages
+  StrategyFactory create;
+
+  /// True if the strategy searches the range in the settings and the
+  /// ranges given to search(), so adaptive ranges apply to it
+  bool            uses_range = false;
+
+  /// True if the strategy uses the global motion given to search(), so it
+  /// is worth estimating
+  bool            uses_global = false;
+
+  /// True if multisize_search() gives the vectors of the strategy, so that
+  /// with a min_blocksize it replaces the strategy and also gives the
+  /// fields at the smaller block sizes
+  bool            uses_multisize = false;
+};
+
+
+/**
+ * Add a search strategy so that MotionEstimator, bma and bmeval can use it
+ * by name. 2dfs, sea, pmvfast, hierarchical, hexagon, epzs and umhexagons
+ * are built in. Register before making estimators; not thread safe.
+ * @param info      name, description and factory
+ * @return false if the name is already registered
+ */
+bool register_strategy(const StrategyInfo &info);
+
+/**
+ * Find a search strategy
+ * @param name      strategy name
+ * @return strategy, or null if no strategy has this name
+ */
+const StrategyInfo *find_strategy(const std::string &name);
+
+/**
+ * All registered search strategies, built in ones first
+ * @return strategies in the order registered
+ */
+const std::vector<StrategyInfo> &strategies();
+
+/**
+ * MotionEstimator
+ * @brief Runs a block matching algorithm frame after frame. The estimator
+ *        owns the output field and every buffer the algorithms need, so
+ *        once the first frame has sized them estimating and refining
+ *        further frames of the same size does not allocate memory.
+ */
+class MotionEstimator
+{
+public:
+  /**
+   * Set up estimator
+   * @param settings   algorithm and block size; if the algorithm is not
+   *                   registered the estimator is not valid()
+   * @param pool       threads to use, or null to run serially; must
+   *                   outlive the estimator
+   */
+  explicit MotionEstimator(const EstimateSettings &settings = EstimateSettings(),
+                           ThreadPool *pool = nullptr);
+
+  MotionEstimator(const MotionEstimator &) = delete;
+  MotionEstimator &operator=(const MotionEstimator &) = delete;
+
+  /**
+   * Estimate integer motion vectors. If the settings have a static
+   * threshold, static blocks are found first and given zero vectors. With
+   * a min_blocksize the fields at smaller block sizes are estimated too.
+   * With an adaptive range the vectors size the search ranges of the next
+   * call; the first frame, and any after the image size changes, are
+   * searched with the full range. With a global motion method the global
+   * motion is estimated first.
+   * @param current_img      current image
+   * @param previous_img     previous image
+   * @param previous_field   previous frame's integer vectors for temporal
+   *                         predictors, or null
+   * @return vectors, valid until the next call
+   */
+  const MotionField &estimate(const cv::Mat &current_img,
+                              const cv::Mat &previous_img,
+                              const MotionField *previous_field = nullptr);
+
+  /**
+   * As above for frames that keep their derived data, so that a frame
+   * searched more than once, e.g. as the current frame of one estimate and
+   * the previous frame of the next or as a reference of several frames, is
+   * only prepared once. The previous frame may be any reference, such as
+   * an earlier or a later frame.
+   * @param current          current frame
+   * @param previous         previous frame
+   * @param previous_field   previous frame's integer vectors for temporal
+   *                         predictors, or null
+   * @return vectors, valid until the next call
+   */
+  const MotionField &estimate(PreparedFrame &current, PreparedFrame &previous,
+                              const MotionField *previous_field = nullptr);
+
+  /**
+   * Build the quarter pixel planes of a previous image for refine() and
+   * for compensation
+   * @param previous_img     previous image
+   * @return interpolated previous image
+   */
+  const InterpolatedReference &interpolate(const cv::Mat &previous_img);
+
+  /**
+   * Use the quarter pixel planes of a prepared previous frame for refine(),
+   * building them if the frame has not already
+   * @param previous         previous frame; must not be replaced before
+   *                         the last refine()
+   * @return interpolated previous image
+   */
+  const InterpolatedReference &interpolate(PreparedFrame &previous);
+
+  /**
+   * Refine the vectors of the last estimate() to quarter pixels against
+   * the image given to the last interpolate(), and those at smaller block
+   * sizes if there are any; static blocks are not refined
+   * @param current_img      current image
+   * @return vectors, valid until the next call
+   */
+  const MotionField &refine(const cv::Mat &current_img);
+
+  /// Vectors of the last estimate() or refine()
+  const MotionField &field() const                 { return(field_); }
+
+  /// Fields of the last estimate() or refine() at the block sizes below
+  /// the one in the settings, smallest first; empty unless the settings
+  /// have a supported min_blocksize for an algorithm with
+  /// StrategyInfo::uses_multisize
+  const std::vector<MotionField> &smaller_fields() const { return(smaller_); }
+
+  /// Static blocks of each of smaller_fields(), every sub-block of a static
+  /// block being static; empty if there is no static threshold
+  const std::vector<SkipMap> &smaller_skip_maps() const
+  {
+    return(smaller_skip_);
+  }
+
+  /// Static blocks of the last estimate(); empty if there is no static
+  /// threshold
+  const SkipMap &skip_map() const                  { return(skip_); }
+
+  /// Search ranges the next estimate() will use; empty unless the range
+  /// is adaptive and the algorithm uses one
+  const RangeMap &ranges() const                   { return(ranges_); }
+
+  /// Set the search ranges the next estimate() will use, e.g. to estimate
+  /// a frame again with the same ones
+  void set_ranges(const RangeMap &ranges)          { ranges_ = ranges; }
+
+  /// Global motion of the last estimate() in whole pixels; zero without a
+  /// global motion method or for an algorithm that does not use it
+  const MotionVector &global_motion() const        { return(global_); }
+
+  /// Interpolated image of the last interpolate()
+  const InterpolatedReference &reference() const   { return(*interpolated_); }
+
+  const EstimateSettings &settings() const         { return(settings_); }
+
+  /// False if the algorithm of the settings is not registered, in which
+  /// case estimate() and refine() give an empty field
+  bool valid() const { return(strategy_ != nullptr); }
+
+  /// Statistics totalled over all frames since the last reset_stats()
+  const EstimateStats &stats() const               { return(stats_); }
+  const SEAStats &sea_stats() const                { return(stats_.sea); }
+  const PMVFASTStats &pmvfast_stats() const        { return(stats_.pmvfast); }
+  void reset_stats();
+
+  /**
+   * Turn per block counters on or off; off by default. Once on, estimate()
+   * and refine() set the counters of each block of the frame.
+   * @param enable     true to count
+   */
+  void enable_block_stats(bool enable)       { block_stats_enabled_ = enable; }
+
+  /// Per block counters of the last estimate() and refine(); the search
+  /// counters of 2dfs, sea and hierarchical are always zero
+  const BlockStatsField &block_stats() const { return(block_stats_); }
+
+private:
+  EstimateSettings                settings_;
+  ThreadPool                     *pool_;
+  std::unique_ptr<SearchStrategy> strategy_;
+  MotionField                     field_;
+  PreparedFrame                   current_frame_, previous_frame_;
+  InterpolatedReference           reference_;
+  const InterpolatedReference    *interpolated_;
+  EstimateStats                   stats_;
+  BlockStatsField                 block_stats_;
+  bool                            block_stats_enabled_;
+  SkipMap                         skip_;
+  std::vector<MotionField>        smaller_;
+  std::vector<SkipMap>            smaller_skip_;
+  MultiSizeWorkspace              multisize_;
+  bool                            uses_multisize_;
+  bool                            uses_range_;
+  RangeMap                        ranges_;
+  RangeWorkspace                  range_workspace_;
+  bool                            uses_global_;
+  MotionVector                    global_;
+  GlobalMotionWorkspace           global_workspace_;
+};
+
+
+/**
+ * Run block matching algorithm once; see MotionEstimator to process a
+ * sequence without allocating per frame
+ * @param current_img      current image
+ * @param previous_img     previous image
+ * @param settings         algorithm and block size
+ * @param pool             threads to use, or null to run serially
+ * @param previous_field   previous frame's integer vectors for temporal
+ *                         predictors, or null
+ * @param sea_stats        if not null, SEA statistics are added to this
+ * @param pmvfast_stats    if not null, PMVFAST statistics are added to this
+ * @return integer motion vectors, empty if the algorithm is not registered
+ */
+MotionField estimate(const cv::Mat &current_img, const cv::Mat &previous_img,
+                     const EstimateSettings &settings, ThreadPool *pool,
+                     const MotionField *previous_field = nullptr,
+                     SEAStats *sea_stats = nullptr,
+                     PMVFASTStats *pmvfast_stats = nullptr);
+
+#endif    // estimate_h
+
@@ -35,44 +35,36 @@ def evaluate_image_quality(image_path1, image_path2):
 
   return psnr_value
 
+# Estimate motion for all frames in one run of bma, returning time taken per frame
+def estimate_sequence(images_path, vectors_path, method, blocksize=16):
+  command = [
+      './bma',
+      '-a', method,
+      '-s', os.path.join(images_path, 'frame_%05d.png'),
+      '-v', os.path.join(vectors_path, 'vectors_%05d.mv'),
+      '-b', str(blocksize),
+      '-t'
+  ]
+  result = subprocess.run(command, stdout=PIPE, check=True)
+
+  # Extract strings matching "Time taken: xxxx microseconds", one per frame
+  return [int(t) for t in re.findall(r'Time taken: (\d+) microseconds', result.stdout.decode())]
+
 # Evaluate motion compensated video frames
 def evaluate_memc(images_path, vectors_path, reconstruct_path, method, blocksize=16):
+  time_taken_list = estimate_sequence(images_path, vectors_path, method, blocksize)
+
   # Loop over each consecutive image pair using number in filenames
   current_index = 2
   previous_index = 1
-  time_taken_list = []
   psnr_list = []
 
-  while True:
+  while current_index < len(time_taken_list) + 2:
     print(f'Processing frame {current_index:05d}...')
     current_image_path = os.path.join(images_path, f'frame_{current_index:05d}.png')
     previous_image_path = os.path.join(images_path, f'frame_{previous_index:05d}.png')
-
-    if not os.path.exists(current_image_path) or not os.path.exists(previous_image_path):
-      break
-
     vectors_output_path = os.path.join(vectors_path, f'vectors_{current_index:05d}.mv')
 
-    # Construct command to perform block matching
-    command = [
-        './bma',
-        '-a', method,
-        '-c', current_image_path,
-        '-p', previous_image_path,
-        '-v', vectors_output_path,
-        '-b', str(blocksize),
-        '-t'
-    ]
-    result = subprocess.run(command, stdout=PIPE, check=True)
-
-    # Extract string matching "Time taken: xxxx microseconds" from result
-    if result.returncode != 0:
-      print(f"Block matching failed for frame {current_index:05d}.")
-      break
-
-    time_taken = int(re.search(r'Time taken: (\d+) microseconds', result.stdout.decode()).group(1))
-    time_taken_list.append(time_taken)
-
     # Reconstruct current image using motion vectors
     reconstructed_image_path = os.path.join(reconstruct_path, f'reconstructed_{current_index:05d}.png')
     command = [
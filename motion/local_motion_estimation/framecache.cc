@@ -0,0 +1,128 @@
+/**
+ * @file   framecache.cc
+ * @brief  Frames with the data derived from them, kept for reuse
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#include <algorithm>
+
+#include "framecache.h"
+
+
+PreparedFrame::PreparedFrame()
+  : index_(0), reference_ready_(false), pyramid_levels_(0)
+{
+}
+
+// Replace image
+void PreparedFrame::set(const cv::Mat &image, int index)
+{
+  image_ = image;
+  index_ = index;
+
+  reference_ready_ = false;
+  pyramid_levels_  = 0;
+  sea_.blk_size    = 0;
+
+  stats_.frames++;
+}
+
+// Replace image with a copy
+void PreparedFrame::copy(const cv::Mat &image, int index)
+{
+  image.copyTo(buffer_);
+  set(buffer_, index);
+}
+
+// Quarter pixel phase planes
+const InterpolatedReference &PreparedFrame::reference()
+{
+  if(!reference_ready_)
+  {
+    reference_.build(image_);
+    reference_ready_ = true;
+    stats_.references++;
+  }
+
+  return(reference_);
+}
+
+// Pyramid of at least levels levels
+const cv::Mat *PreparedFrame::pyramid(int levels)
+{
+  levels = std::min(levels, HIER_MAX_LEVELS);
+
+  if(levels > pyramid_levels_)
+  {
+    // Levels already built are kept
+
+    if(pyramid_levels_ == 0)
+    {
+      pyramid_[0] = image_;
+      pyramid_levels_ = 1;
+    }
+
+    for(int level = pyramid_levels_; level < levels; level++)
+      cv::pyrDown(pyramid_[level-1], pyramid_[level]);
+
+    pyramid_levels_ = levels;
+    stats_.pyramids++;
+  }
+
+  return(pyramid_);
+}
+
+// Sub-block sums for a block size
+const SEAPlanes &PreparedFrame::sea_planes(int blk_size)
+{
+  if(sea_.blk_size != blk_size)
+  {
+    ::sea_planes(image_, blk_size, integral_, sea_);
+    stats_.sea_planes++;
+  }
+
+  return(sea_);
+}
+
+
+FrameCache::FrameCache(int capacity) : next_(0)
+{
+  for(int i = 0; i < std::max(capacity, 1); i++)
+    frames_.push_back(std::make_unique<PreparedFrame>());
+}
+
+// Copy frame in place of the oldest
+PreparedFrame &FrameCache::add(const cv::Mat &image, int index)
+{
+  PreparedFrame &frame = *frames_[next_];
+  next_ = (next_ + 1) % capacity();
+
+  frame.copy(image, index);
+  return(frame);
+}
+
+// Find frame by number
+PreparedFrame *FrameCache::find(int index)
+{
+  for(auto &frame : frames_)
+    if(!frame->empty() && (frame->index() == index)) return(frame.get());
+
+  return(nullptr);
+}
+
+// Total data built
+PreparedStats FrameCache::stats() const
+{
+  PreparedStats total;
+
+  for(const auto &frame : frames_)
+  {
+    total.frames     += frame->stats().frames;
+    total.references += frame->stats().references;
+    total.pyramids   += frame->stats().pyramids;
+    total.sea_planes += frame->stats().sea_planes;
+  }
+
+  return(total);
+}
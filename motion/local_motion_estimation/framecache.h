@@ -0,0 +1,160 @@
+/**
+ * @file   framecache.h
+ * @brief  Frames with the data derived from them, kept for reuse
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#ifndef framecache_h
+#define framecache_h
+
+#include <memory>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "fullsearch.h"
+#include "hierarchical.h"
+#include "interpolatedref.h"
+
+/// Default number of frames held by a FrameCache
+#define FRAME_CACHE_SIZE 4
+
+
+/// Number of times each kind of derived data was built
+struct PreparedStats
+{
+  long long frames     = 0;    ///< images given to frames
+  long long references = 0;    ///< quarter pixel phase planes
+  long long pyramids   = 0;    ///< pyramids built or made deeper
+  long long sea_planes = 0;    ///< successive elimination sub-block sums
+};
+
+
+/**
+ * PreparedFrame
+ * @brief A luma frame and the data derived from it: its padded quarter
+ *        pixel phase planes, its pyramid and its sub-block sums. Each is
+ *        built the first time it is asked for and kept until the image is
+ *        replaced, so a frame that is the current image of one search and
+ *        the reference of others is only prepared once. Buffers are kept
+ *        when the image is replaced, so frames of the same size do not
+ *        allocate memory. Not thread safe; derived data is built by the
+ *        thread that asks for it.
+ */
+class PreparedFrame
+{
+public:
+  PreparedFrame();
+
+  PreparedFrame(const PreparedFrame &) = delete;
+  PreparedFrame &operator=(const PreparedFrame &) = delete;
+
+  /**
+   * Replace the image with one the frame shares; data derived from the old
+   * image is dropped
+   * @param image     single channel uchar image
+   * @param index     frame number
+   */
+  void set(const cv::Mat &image, int index = 0);
+
+  /**
+   * As set() but copy the image into a buffer of the frame, so the caller
+   * may reuse its own
+   * @param image     single channel uchar image
+   * @param index     frame number
+   */
+  void copy(const cv::Mat &image, int index = 0);
+
+  /// Image of the frame
+  const cv::Mat &image() const   { return(image_); }
+
+  /// Frame number given to set() or copy()
+  int index() const              { return(index_); }
+
+  /// True if there is no image
+  bool empty() const             { return(image_.empty()); }
+
+  /**
+   * Quarter pixel phase planes of the image, built on first use
+   * @return planes, valid until the image is replaced
+   */
+  const InterpolatedReference &reference();
+
+  /**
+   * Pyramid of the image as built by hierarchical_pyramid(), built or made
+   * deeper on first use
+   * @param levels    number of levels, at most HIER_MAX_LEVELS
+   * @return levels, valid until the image is replaced
+   */
+  const cv::Mat *pyramid(int levels);
+
+  /**
+   * Sub-block sums of the image for successive elimination as calculated
+   * by sea_planes(), built on first use or when the block size changes
+   * @param blk_size  block size
+   * @return sums, valid until the image is replaced
+   */
+  const SEAPlanes &sea_planes(int blk_size);
+
+  /// Data built since the frame was made
+  const PreparedStats &stats() const { return(stats_); }
+
+private:
+  cv::Mat               image_;
+  cv::Mat               buffer_;           // Copy of image for copy()
+  int                   index_;
+
+  InterpolatedReference reference_;
+  bool                  reference_ready_;
+  cv::Mat               pyramid_[HIER_MAX_LEVELS];
+  int                   pyramid_levels_;
+  SEAPlanes             sea_;
+  cv::Mat               integral_;
+
+  PreparedStats         stats_;
+};
+
+
+/**
+ * FrameCache
+ * @brief Ring buffer of the last few frames of a sequence. Adding a frame
+ *        replaces the oldest, reusing its buffers, so a frame stays
+ *        prepared for as long as it is in the cache.
+ */
+class FrameCache
+{
+public:
+  /**
+   * Set up cache
+   * @param capacity   number of frames held; at least 1
+   */
+  explicit FrameCache(int capacity = FRAME_CACHE_SIZE);
+
+  /**
+   * Copy a frame into the cache in place of the oldest one
+   * @param image      single channel uchar image
+   * @param index      frame number; unique among the frames held
+   * @return frame, valid until capacity() more frames are added
+   */
+  PreparedFrame &add(const cv::Mat &image, int index);
+
+  /**
+   * Find a frame by frame number
+   * @param index      frame number
+   * @return frame, or null if it is not held
+   */
+  PreparedFrame *find(int index);
+
+  /// Number of frames held
+  int capacity() const             { return((int)frames_.size()); }
+
+  /// Data built by all the frames of the cache
+  PreparedStats stats() const;
+
+private:
+  std::vector<std::unique_ptr<PreparedFrame>> frames_;
+  int                                         next_;
+};
+
+#endif    // framecache_h
@@ -7,64 +7,412 @@
 
 #include "fullsearch.h"
 #include "bmsupport.h"
+#include "sadkernels.h"
+#include "staticblocks.h"
+#include "searchrange.h"
 
 
 // 2D Full Search
-std::vector<cv::Vec2f> fullsearch(const cv::Mat &current, const cv::Mat &previous,
-                                  int blk_size)
+MotionField fullsearch(const cv::Mat &current, const cv::Mat &previous,
+                       int blk_size)
 {
-  std::vector<cv::Vec2f> mv;
+  MotionField mv;
+  fullsearch(current, previous, blk_size, nullptr, mv);
+  return(mv);
+}
 
+// 2D Full Search, parallel over block rows
+MotionField fullsearch(const cv::Mat &current, const cv::Mat &previous,
+                       int blk_size, ThreadPool &pool)
+{
+  MotionField mv;
+  fullsearch(current, previous, blk_size, &pool, mv);
+  return(mv);
+}
+
+// 2D Full Search into existing field; serial if pool is null
+void fullsearch(const cv::Mat &current, const cv::Mat &previous, int blk_size,
+                ThreadPool *pool, MotionField &mv, const SkipMap *skip,
+                int range, const RangeMap *ranges, MotionVector centre)
+{
   int blocks_wide = current.cols/blk_size;
   int blocks_high = current.rows/blk_size;
 
-  int xmin, xmax, ymin, ymax;    // bounds of search origin
-  float bdm, bestbdm;            // BDM = block distortion measure
-  cv::Vec2f bestvec;
+  mv.resize(blocks_wide*blocks_high);
 
-  // Process image by block
+  // Each block row is written by one thread only
 
-  for(int by = 0; by < blocks_high; by++)
+  auto process_row = [&](int by)
   {
     for(int bx = 0; bx < blocks_wide; bx++)
     {
-      bestvec = cv::Vec2f(0.0, 0.0);
-      bestbdm = 1e7;
+      int index = by*blocks_wide + bx;
+
+      if(is_static(skip, index))
+        mv[index] = MotionVector(0, 0);
+      else
+        mv[index] = fullsearch_block(current, previous, bx*blk_size,
+                                     by*blk_size, blk_size,
+                                     block_range(ranges, index, range),
+                                     centre);
+    }
+  };
+
+  if(pool)
+    pool->parallel_for(blocks_high, process_row);
+  else
+  {
+    for(int by = 0; by < blocks_high; by++) process_row(by);
+  }
+}
+
+// Windows of a block, the one around the zero vector first
+SearchWindow::SearchWindow(const cv::Mat &previous, int ox, int oy,
+                           int blk_size, int range, MotionVector centre)
+{
+  int cx = centre[0]/MV_UNIT;
+  int cy = centre[1]/MV_UNIT;
+
+  count = 0;
+
+  for(int w = 0; w < 2; w++)
+  {
+    int dx = w ? cx : 0;
+    int dy = w ? cy : 0;
+
+    if(w && (dx == 0) && (dy == 0)) break;
+
+    xmin[count] = std::clamp(ox + dx - range, 0, previous.cols);
+    xmax[count] = std::clamp(ox + dx + range, 0, previous.cols - blk_size);
+    ymin[count] = std::clamp(oy + dy - range, 0, previous.rows);
+    ymax[count] = std::clamp(oy + dy + range, 0, previous.rows - blk_size);
+
+    // The window around the zero vector always holds it; the other may be
+    // off the image
+
+    if((xmin[count] <= xmax[count]) && (ymin[count] <= ymax[count])) count++;
+  }
+}
+
+// First row of candidates
+int SearchWindow::top() const
+{
+  return((count > 1) ? std::min(ymin[0], ymin[1]) : ymin[0]);
+}
+
+// Last row of candidates
+int SearchWindow::bottom() const
+{
+  return((count > 1) ? std::max(ymax[0], ymax[1]) : ymax[0]);
+}
+
+// Runs of candidates in a row, merging windows that overlap or touch
+int SearchWindow::runs(int y, int x0[2], int x1[2]) const
+{
+  int n = 0;
+
+  for(int w = 0; w < count; w++)
+  {
+    if((y < ymin[w]) || (y > ymax[w])) continue;
+
+    x0[n] = xmin[w];
+    x1[n] = xmax[w];
+    n++;
+  }
+
+  if(n == 2)
+  {
+    if(x0[1] < x0[0])
+    {
+      std::swap(x0[0], x0[1]);
+      std::swap(x1[0], x1[1]);
+    }
+
+    if(x0[1] <= x1[0] + 1)
+    {
+      x1[0] = std::max(x1[0], x1[1]);
+      n = 1;
+    }
+  }
+
+  return(n);
+}
+
+// 2D Full Search of a single block
+MotionVector fullsearch_block(const cv::Mat &current, const cv::Mat &previous,
+                              int ox, int oy, int blk_size, int range,
+                              MotionVector centre)
+{
+  int bestbdm;                   // BDM = block distortion measure
+  MotionVector bestvec;
+
+  bestvec = MotionVector(0, 0);
+  bestbdm = 10000000;
+
+  // Find bounds of search
+
+  SearchWindow window(previous, ox, oy, blk_size, range, centre);
+
+  // Prefer a (0,0) motion vector; if all is equal
+
+  auto consider = [&](int x, int y, int bdm)
+  {
+    if((bdm < bestbdm) || ((bdm == bestbdm) && (x == ox) && (y == oy)))
+    {
+      bestbdm = bdm;
+      bestvec = mv_pixels(x-ox, y-oy);
+    }
+  };
 
-      int ox = bx*blk_size;
-      int oy = by*blk_size;
+  // Where there is a candidates kernel, each run of the cost surface is
+  // calculated SAD_CANDIDATES at a time, as far as its reads stay in the
+  // image; the last group of a run overlaps the one before rather than
+  // falling back to single SADs. The rest use bounded SADs. Candidates are
+  // considered in the same order either way, so the result is the same.
 
-      // Find bounds of search
+  sad_candidates_fn candidates = sad_candidates_kernel(blk_size);
 
-      xmin = ox - RANGE; xmax = ox + RANGE;
-      ymin = oy - RANGE; ymax = oy + RANGE;
+  int xlimit = previous.cols - blk_size - SAD_CANDIDATES_SPAN;
 
-      xmin = std::clamp(xmin, 0, previous.cols);
-      xmax = std::clamp(xmax, 0, previous.cols - blk_size);
-      ymin = std::clamp(ymin, 0, previous.rows);
-      ymax = std::clamp(ymax, 0, previous.rows - blk_size);
+  const unsigned char *ref = current.ptr<unsigned char>(oy) + ox;
+  unsigned int sads[SAD_CANDIDATES];
+  int x0[2], x1[2];
 
-      // Search
+  // Search
 
-      for(int y = ymin; y <= ymax; y++)
+  for(int y = window.top(); y <= window.bottom(); y++)
+  {
+    int runs = window.runs(y, x0, x1);
+
+    for(int r = 0; r < runs; r++)
+    {
+      int x = x0[r];
+      int xmax = x1[r];
+      int xlast = std::min(xmax, xlimit) - (SAD_CANDIDATES-1);
+
+      if(candidates && (xlast >= x))
       {
-        for(int x = xmin; x <= xmax; x++)
+        const unsigned char *row = previous.ptr<unsigned char>(y);
+
+        while(x <= xlast + (SAD_CANDIDATES-1))
         {
-          bdm = SAD(current, previous, ox, oy, x, y, blk_size);
-
-          // Prefer a (0,0) motion vector; if all is equal
-          if((bdm < bestbdm) || ((bdm == bestbdm) && (x == ox) && (y == oy)))
-          {
-            bestbdm = bdm;
-            bestvec[0] = x-ox;
-            bestvec[1] = y-oy;
-          }
+          int start = std::min(x, xlast);
+          candidates(ref, current.step, row + start, previous.step, sads);
+
+          for(int i = x - start; i < SAD_CANDIDATES; i++)
+            consider(start + i, y, sads[i]);
+
+          x = start + SAD_CANDIDATES;
         }
       }
 
-      mv.push_back(bestvec);
+      for(; x <= xmax; x++)
+        consider(x, y, SAD_integer_bounded(current, previous, ox, oy, x, y,
+                                           blk_size, bestbdm));
     }
   }
 
+  return(bestvec);
+}
+
+// Calculate sub-block sums from integral image
+void sea_planes(const cv::Mat &img, int blk_size, cv::Mat &integral,
+                SEAPlanes &planes)
+{
+  cv::integral(img, integral, CV_32S);
+
+  planes.blk_size = blk_size;
+  planes.levels   = 0;
+
+  for(int l = 0; l < SEA_MAX_LEVELS; l++)
+  {
+    int sub = blk_size >> l;
+    if((l > 0) && ((sub < SEA_MIN_SUBBLOCK) || ((sub << l) != blk_size)))
+      break;
+
+    cv::Mat &sums = planes.sums[l];
+    sums.create(img.rows - sub + 1, img.cols - sub + 1, CV_32S);
+
+    for(int y = 0; y < sums.rows; y++)
+    {
+      const int *top = integral.ptr<int>(y);
+      const int *bot = integral.ptr<int>(y+sub);
+      int *out = sums.ptr<int>(y);
+
+      for(int x = 0; x < sums.cols; x++)
+        out[x] = bot[x+sub] - bot[x] - top[x+sub] + top[x];
+    }
+
+    planes.sub[l] = sub;
+    planes.levels++;
+  }
+}
+
+// Full search of a single block with successive elimination
+static MotionVector sea_block(const cv::Mat &current, const cv::Mat &previous,
+                              const SEAPlanes &cur_planes,
+                              const SEAPlanes &prev_planes,
+                              int ox, int oy, int blk_size, int range,
+                              MotionVector centre, SEAStats &stats)
+{
+  int levels = prev_planes.levels;
+  int cur_sums[SEA_MAX_LEVELS][1 << (2*(SEA_MAX_LEVELS-1))];
+
+  // Sub-block sums of current block
+
+  for(int l = 0; l < levels; l++)
+  {
+    int n = 1 << l;
+    int sub = cur_planes.sub[l];
+
+    for(int j = 0; j < n; j++)
+      for(int i = 0; i < n; i++)
+        cur_sums[l][j*n + i] = cur_planes.sums[l].at<int>(oy + j*sub, ox + i*sub);
+  }
+
+  // Start with the zero vector; as only a lower SAD can then replace it, any
+  // candidate with a bound at or above the best SAD can be rejected and the
+  // result is the same as fullsearch_block()
+
+  MotionVector bestvec(0, 0);
+  int bestbdm = SAD_integer(current, previous, ox, oy, ox, oy, blk_size);
+
+  SearchWindow window(previous, ox, oy, blk_size, range, centre);
+  int x0[2], x1[2];
+
+  // Check one candidate
+
+  auto check = [&](int x, int y)
+  {
+    // Check lower bounds from coarse to fine
+
+    for(int l = 0; l < levels; l++)
+    {
+      int n = 1 << l;
+      int sub = prev_planes.sub[l];
+      const cv::Mat &sums = prev_planes.sums[l];
+      int bound = 0;
+
+      for(int j = 0; j < n; j++)
+      {
+        const int *row = sums.ptr<int>(y + j*sub) + x;
+        for(int i = 0; i < n; i++)
+          bound += std::abs(cur_sums[l][j*n + i] - row[i*sub]);
+      }
+
+      if(bound >= bestbdm)
+      {
+        stats.eliminated++;
+        return;
+      }
+    }
+
+    int bdm = SAD_integer_bounded(current, previous, ox, oy, x, y, blk_size,
+                                  bestbdm);
+
+    if(bdm < bestbdm)
+    {
+      bestbdm = bdm;
+      bestvec = mv_pixels(x-ox, y-oy);
+    }
+  };
+
+  for(int y = window.top(); y <= window.bottom(); y++)
+  {
+    int runs = window.runs(y, x0, x1);
+
+    for(int r = 0; r < runs; r++)
+    {
+      stats.candidates += x1[r] - x0[r] + 1;
+
+      for(int x = x0[r]; x <= x1[r]; x++)
+        if((x != ox) || (y != oy)) check(x, y);
+    }
+  }
+
+  return(bestvec);
+}
+
+// Successive elimination full search
+MotionField fullsearch_sea(const cv::Mat &current, const cv::Mat &previous,
+                           int blk_size, SEAStats *stats)
+{
+  SEAWorkspace workspace;
+  MotionField mv;
+  fullsearch_sea(current, previous, blk_size, nullptr, workspace, mv, stats);
+  return(mv);
+}
+
+// Successive elimination full search, parallel over block rows
+MotionField fullsearch_sea(const cv::Mat &current, const cv::Mat &previous,
+                           int blk_size, ThreadPool &pool,
+                           SEAStats *stats)
+{
+  SEAWorkspace workspace;
+  MotionField mv;
+  fullsearch_sea(current, previous, blk_size, &pool, workspace, mv, stats);
   return(mv);
 }
+
+// Successive elimination full search with workspace; serial if pool is null
+void fullsearch_sea(const cv::Mat &current, const cv::Mat &previous,
+                    int blk_size, ThreadPool *pool, SEAWorkspace &workspace,
+                    MotionField &mv, SEAStats *stats, const SkipMap *skip,
+                    int range, const RangeMap *ranges, MotionVector centre)
+{
+  sea_planes(current, blk_size, workspace.integral, workspace.current);
+  sea_planes(previous, blk_size, workspace.integral, workspace.previous);
+
+  fullsearch_sea(current, previous, blk_size, pool, workspace.current,
+                 workspace.previous, workspace, mv, stats, skip, range, ranges,
+                 centre);
+}
+
+// Successive elimination full search with sub-block sums already calculated
+void fullsearch_sea(const cv::Mat &current, const cv::Mat &previous,
+                    int blk_size, ThreadPool *pool,
+                    const SEAPlanes &cur_planes, const SEAPlanes &prev_planes,
+                    SEAWorkspace &workspace, MotionField &mv, SEAStats *stats,
+                    const SkipMap *skip, int range, const RangeMap *ranges,
+                    MotionVector centre)
+{
+  int blocks_wide = current.cols/blk_size;
+  int blocks_high = current.rows/blk_size;
+
+  mv.resize(blocks_wide*blocks_high);
+
+  std::vector<SEAStats> &row_stats = workspace.row_stats;
+  row_stats.assign(blocks_high, SEAStats());
+
+  auto process_row = [&](int by)
+  {
+    for(int bx = 0; bx < blocks_wide; bx++)
+    {
+      int index = by*blocks_wide + bx;
+
+      if(is_static(skip, index))
+        mv[index] = MotionVector(0, 0);
+      else
+        mv[index] = sea_block(current, previous, cur_planes, prev_planes,
+                              bx*blk_size, by*blk_size, blk_size,
+                              block_range(ranges, index, range), centre,
+                              row_stats[by]);
+    }
+  };
+
+  if(pool)
+    pool->parallel_for(blocks_high, process_row);
+  else
+  {
+    for(int by = 0; by < blocks_high; by++) process_row(by);
+  }
+
+  if(stats)
+  {
+    for(const SEAStats &rs : row_stats)
+    {
+      stats->candidates += rs.candidates;
+      stats->eliminated += rs.eliminated;
+    }
+  }
+}
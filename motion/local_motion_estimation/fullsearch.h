@@ -14,9 +14,91 @@
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 
-/// Search range for full search
+#include "threadpool.h"
+#include "motionvector.h"
+
+/// Default search range for full search, in pixels
 #define RANGE 16
 
+/// Most levels of sub-block sums used by successive elimination; up to 4.
+/// Level l splits the block into 4^l sub-blocks; with the SIMD SAD kernels
+/// more than two levels tends to cost more than it saves
+#define SEA_MAX_LEVELS 2
+
+/// Smallest sub-block used by successive elimination
+#define SEA_MIN_SUBBLOCK 4
+
+
+/// Counters from successive elimination full search
+struct SEAStats
+{
+  long long candidates = 0;    ///< candidate positions in all search windows
+  long long eliminated = 0;    ///< candidates rejected without a SAD
+};
+
+/// Sub-block sums of an image at every position for successive elimination
+struct SEAPlanes
+{
+  int     blk_size = 0;               ///< block size the sums are for
+  int     levels = 0;                 ///< level l has 4^l sub-blocks per block
+  int     sub[SEA_MAX_LEVELS];        ///< sub-block size at each level
+  cv::Mat sums[SEA_MAX_LEVELS];       ///< sum of sub-block at each origin
+};
+
+/// Buffers for successive elimination, kept from frame to frame so that
+/// they are only allocated when the image size changes
+struct SEAWorkspace
+{
+  cv::Mat               integral;
+  SEAPlanes             current, previous;
+  std::vector<SEAStats> row_stats;
+};
+
+
+/**
+ * SearchWindow
+ * @brief Candidates of a full search of one block: the search origins
+ *        within range of the block moved by centre and, if centre is not
+ *        zero, those within range of the block itself, so that blocks that
+ *        do not follow the global motion are still searched. Both windows
+ *        are clipped to the image. Candidates are searched a row at a time
+ *        in raster order; where both windows cover a row it has one or two
+ *        runs.
+ */
+struct SearchWindow
+{
+  int count;                 ///< windows that are not empty, 1 or 2
+  int xmin[2], xmax[2];      ///< bounds of search origin of each window
+  int ymin[2], ymax[2];
+
+  /**
+   * Find the windows of a block
+   * @param previous   previous image
+   * @param ox         x co-ordinate of block origin in current image
+   * @param oy         y co-ordinate of block origin in current image
+   * @param blk_size   block size
+   * @param range      search range in pixels
+   * @param centre     centre of the second window, a whole number of pixels
+   */
+  SearchWindow(const cv::Mat &previous, int ox, int oy, int blk_size,
+               int range, MotionVector centre);
+
+  /// First row of candidates
+  int top() const;
+
+  /// Last row of candidates
+  int bottom() const;
+
+  /**
+   * Runs of candidates in a row
+   * @param y          row
+   * @param x0         set to the first x of each run, in increasing order
+   * @param x1         set to the last x of each run
+   * @return number of runs, 0 to 2
+   */
+  int runs(int y, int x0[2], int x1[2]) const;
+};
+
 
 /**
  * fullsearch
@@ -26,8 +108,163 @@
  * @param blk_size   block size
  * @return  motion vectors
  */
-std::vector<cv::Vec2f> fullsearch(const cv::Mat &current, const cv::Mat &previous,
-                                  int blk_size);
+MotionField fullsearch(const cv::Mat &current, const cv::Mat &previous,
+                       int blk_size);
+
+/**
+ * fullsearch
+ * @brief 2D Full Search block matching algorithm with block rows spread
+ *        across a thread pool; gives the same vectors as the serial version
+ * @param current    current image
+ * @param previous   previous image
+ * @param blk_size   block size
+ * @param pool       threads to use
+ * @return  motion vectors
+ */
+MotionField fullsearch(const cv::Mat &current, const cv::Mat &previous,
+                       int blk_size, ThreadPool &pool);
+
+/**
+ * fullsearch
+ * @brief 2D Full Search into an existing field, which is only reallocated
+ *        if its size changes
+ * @param current    current image
+ * @param previous   previous image
+ * @param blk_size   block size
+ * @param pool       threads to use, or null to run serially
+ * @param mv         motion vectors
+ * @param skip       if not null, static blocks are given a zero vector
+ *                   without a search
+ * @param range      search range in pixels
+ * @param ranges     if not null, the search range of each block, in place
+ *                   of range
+ * @param centre     centre of the second search window, a whole number of
+ *                   pixels, e.g. the global motion; see SearchWindow
+ */
+void fullsearch(const cv::Mat &current, const cv::Mat &previous, int blk_size,
+                ThreadPool *pool, MotionField &mv,
+                const SkipMap *skip = nullptr, int range = RANGE,
+                const RangeMap *ranges = nullptr,
+                MotionVector centre = MotionVector(0, 0));
+
+/**
+ * fullsearch_block
+ * @brief 2D Full Search for a single block over the candidates of a
+ *        SearchWindow. Ties go to the zero vector, otherwise to the first
+ *        candidate in raster order.
+ * @param current    current image
+ * @param previous   previous image
+ * @param ox         x co-ordinate of block origin in current image
+ * @param oy         y co-ordinate of block origin in current image
+ * @param blk_size   block size
+ * @param range      search range in pixels
+ * @param centre     centre of the second window, a whole number of pixels
+ * @return  motion vector of block, a whole number of pixels
+ */
+MotionVector fullsearch_block(const cv::Mat &current, const cv::Mat &previous,
+                              int ox, int oy, int blk_size, int range = RANGE,
+                              MotionVector centre = MotionVector(0, 0));
+
+/**
+ * fullsearch_sea
+ * @brief 2D Full Search using the multilevel Successive Elimination
+ *        Algorithm. The block and each candidate are split into 1, 4, 16...
+ *        sub-blocks; the sum of absolute differences of the sub-block sums
+ *        is a lower bound on SAD that tightens with each level, so any
+ *        candidate whose bound reaches the best SAD so far is rejected
+ *        without calculating its SAD. Sub-block sums of the previous image
+ *        are precomputed for every position from its integral image.
+ *        Gives the same vectors as fullsearch(), including preferring (0,0).
+ * @param current    current image
+ * @param previous   previous image
+ * @param blk_size   block size
+ * @param stats      if not null, counters are added to this
+ * @return  motion vectors
+ */
+MotionField fullsearch_sea(const cv::Mat &current, const cv::Mat &previous,
+                           int blk_size, SEAStats *stats = nullptr);
+
+/**
+ * fullsearch_sea
+ * @brief As above with block rows spread across a thread pool
+ * @param current    current image
+ * @param previous   previous image
+ * @param blk_size   block size
+ * @param pool       threads to use
+ * @param stats      if not null, counters are added to this
+ * @return  motion vectors
+ */
+MotionField fullsearch_sea(const cv::Mat &current, const cv::Mat &previous,
+                           int blk_size, ThreadPool &pool,
+                           SEAStats *stats = nullptr);
+
+/**
+ * fullsearch_sea
+ * @brief As above using the buffers of a workspace and writing into an
+ *        existing field, so that nothing is allocated from frame to frame
+ * @param current    current image
+ * @param previous   previous image
+ * @param blk_size   block size
+ * @param pool       threads to use, or null to run serially
+ * @param workspace  buffers
+ * @param mv         motion vectors
+ * @param stats      if not null, counters are added to this
+ * @param skip       if not null, static blocks are given a zero vector
+ *                   without a search
+ * @param range      search range in pixels
+ * @param ranges     if not null, the search range of each block, in place
+ *                   of range
+ * @param centre     centre of the second search window, a whole number of
+ *                   pixels; see SearchWindow
+ */
+void fullsearch_sea(const cv::Mat &current, const cv::Mat &previous,
+                    int blk_size, ThreadPool *pool, SEAWorkspace &workspace,
+                    MotionField &mv, SEAStats *stats = nullptr,
+                    const SkipMap *skip = nullptr, int range = RANGE,
+                    const RangeMap *ranges = nullptr,
+                    MotionVector centre = MotionVector(0, 0));
+
+/**
+ * fullsearch_sea
+ * @brief As above with sub-block sums already calculated by sea_planes(),
+ *        e.g. kept with a frame that is searched more than once; the
+ *        workspace only holds the per row counters
+ * @param current    current image
+ * @param previous   previous image
+ * @param blk_size   block size
+ * @param pool       threads to use, or null to run serially
+ * @param current_planes   sub-block sums of current for blk_size
+ * @param previous_planes  sub-block sums of previous for blk_size
+ * @param workspace  buffers
+ * @param mv         motion vectors
+ * @param stats      if not null, counters are added to this
+ * @param skip       if not null, static blocks are given a zero vector
+ *                   without a search
+ * @param range      search range in pixels
+ * @param ranges     if not null, the search range of each block, in place
+ *                   of range
+ * @param centre     centre of the second search window, a whole number of
+ *                   pixels; see SearchWindow
+ */
+void fullsearch_sea(const cv::Mat &current, const cv::Mat &previous,
+                    int blk_size, ThreadPool *pool,
+                    const SEAPlanes &current_planes,
+                    const SEAPlanes &previous_planes,
+                    SEAWorkspace &workspace, MotionField &mv,
+                    SEAStats *stats = nullptr, const SkipMap *skip = nullptr,
+                    int range = RANGE, const RangeMap *ranges = nullptr,
+                    MotionVector centre = MotionVector(0, 0));
+
+/**
+ * Calculate the sub-block sums of an image at every position for
+ * successive elimination with a block size, from its integral image
+ * @param img        image
+ * @param blk_size   block size
+ * @param integral   buffer for the integral image
+ * @param planes     sub-block sums
+ */
+void sea_planes(const cv::Mat &img, int blk_size, cv::Mat &integral,
+                SEAPlanes &planes);
 
 #endif    // fullsearch_h
 
@@ -0,0 +1,129 @@
+/**
+ * @file   globalmotion.cc
+ * @brief  Estimate the global translation between a pair of frames
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#include <cmath>
+#include <algorithm>
+
+#include <opencv2/imgproc.hpp>
+
+#include "globalmotion.h"
+
+
+// Name of global motion method
+const char *global_motion_name(GlobalMotionMethod method)
+{
+  switch(method) {
+    case GLOBAL_PHASE:    return("phase");
+    case GLOBAL_FEATURES: return("features");
+    default:              return("none");
+  }
+}
+
+// Find global motion method by name
+bool find_global_motion_method(const std::string &name,
+                               GlobalMotionMethod &method)
+{
+  for(GlobalMotionMethod m : { GLOBAL_NONE, GLOBAL_PHASE, GLOBAL_FEATURES })
+  {
+    if(name == global_motion_name(m))
+    {
+      method = m;
+      return(true);
+    }
+  }
+
+  return(false);
+}
+
+// Translation by phase correlation. cv::phaseCorrelate() gives the shift d
+// of its second image from its first, previous(x) = current(x - d), so d
+// is also the vector from the current frame to the previous one.
+static cv::Point2d phase_shift(const cv::Mat &current, const cv::Mat &previous,
+                               GlobalMotionWorkspace &workspace)
+{
+  current.convertTo(workspace.current, CV_32F);
+  previous.convertTo(workspace.previous, CV_32F);
+
+  if(workspace.window.size() != current.size())
+    cv::createHanningWindow(workspace.window, current.size(), CV_32F);
+
+  return(cv::phaseCorrelate(workspace.current, workspace.previous,
+                            workspace.window));
+}
+
+// Translation as the median motion of matched features, as gfm does
+static bool feature_shift(const cv::Mat &current, const cv::Mat &previous,
+                          GlobalMotionWorkspace &workspace, cv::Point2d &shift)
+{
+  if(!workspace.orb) workspace.orb = cv::ORB::create(GLOBAL_ORB_FEATURES);
+
+  workspace.orb->detectAndCompute(current, cv::noArray(),
+                                  workspace.current_points,
+                                  workspace.current_descriptors);
+  workspace.orb->detectAndCompute(previous, cv::noArray(),
+                                  workspace.previous_points,
+                                  workspace.previous_descriptors);
+
+  workspace.matches.clear();
+
+  if(!workspace.current_descriptors.empty() &&
+     !workspace.previous_descriptors.empty())
+  {
+    cv::BFMatcher matcher(cv::NORM_HAMMING);
+    matcher.match(workspace.current_descriptors,
+                  workspace.previous_descriptors, workspace.matches);
+  }
+
+  if(workspace.matches.size() < GLOBAL_MIN_MATCHES) return(false);
+
+  std::vector<float> &mv_x = workspace.mv_x;
+  std::vector<float> &mv_y = workspace.mv_y;
+  mv_x.clear();
+  mv_y.clear();
+
+  for(const cv::DMatch &match : workspace.matches)
+  {
+    cv::Point2f pt_current  = workspace.current_points[match.queryIdx].pt;
+    cv::Point2f pt_previous = workspace.previous_points[match.trainIdx].pt;
+    mv_x.push_back(pt_previous.x - pt_current.x);
+    mv_y.push_back(pt_previous.y - pt_current.y);
+  }
+
+  size_t middle = mv_x.size()/2;
+  std::nth_element(mv_x.begin(), mv_x.begin() + middle, mv_x.end());
+  std::nth_element(mv_y.begin(), mv_y.begin() + middle, mv_y.end());
+
+  shift = cv::Point2d(mv_x[middle], mv_y[middle]);
+  return(true);
+}
+
+// Estimate global translation
+bool global_motion(const cv::Mat &current, const cv::Mat &previous,
+                   GlobalMotionMethod method, GlobalMotionWorkspace &workspace,
+                   MotionVector &offset)
+{
+  offset = MotionVector(0, 0);
+
+  cv::Point2d shift;
+
+  switch(method)
+  {
+    case GLOBAL_PHASE:
+    shift = phase_shift(current, previous, workspace);
+    break;
+
+    case GLOBAL_FEATURES:
+    if(!feature_shift(current, previous, workspace, shift)) return(false);
+    break;
+
+    default:
+    return(true);
+  }
+
+  offset = mv_pixels((int)std::lround(shift.x), (int)std::lround(shift.y));
+  return(true);
+}
@@ -0,0 +1,84 @@
+/**
+ * @file   globalmotion.h
+ * @brief  Estimate the global translation between a pair of frames
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#ifndef globalmotion_h
+#define globalmotion_h
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+
+#include "motionvector.h"
+
+/// Number of ORB features to detect in each frame
+#define GLOBAL_ORB_FEATURES 500
+
+/// Fewest feature matches for a global translation; fewer gives none
+#define GLOBAL_MIN_MATCHES 10
+
+
+/// How to estimate the global translation of a frame
+enum GlobalMotionMethod
+{
+  GLOBAL_NONE,        ///< no global motion; searches centre on zero
+  GLOBAL_PHASE,       ///< phase correlation of the whole frames
+  GLOBAL_FEATURES     ///< median motion of matched ORB features, as gfm
+};
+
+/// Buffers for global_motion(), kept from frame to frame
+struct GlobalMotionWorkspace
+{
+  cv::Mat                   current, previous;   ///< float frames
+  cv::Mat                   window;              ///< Hanning window
+  cv::Ptr<cv::ORB>          orb;
+  std::vector<cv::KeyPoint> current_points, previous_points;
+  cv::Mat                   current_descriptors, previous_descriptors;
+  std::vector<cv::DMatch>   matches;
+  std::vector<float>        mv_x, mv_y;
+};
+
+
+/**
+ * Name of a global motion method; "none", "phase" or "features"
+ * @param method     method
+ * @return name
+ */
+const char *global_motion_name(GlobalMotionMethod method);
+
+/**
+ * Find a global motion method by name
+ * @param name       name as given by global_motion_name()
+ * @param method     set to the method if found
+ * @return true if found
+ */
+bool find_global_motion_method(const std::string &name,
+                               GlobalMotionMethod &method);
+
+/**
+ * global_motion
+ * @brief Estimate the translation of the whole current frame from the
+ *        previous one, as a vector that is added to co-ordinates in the
+ *        current frame, like block vectors. Phase correlation finds the
+ *        peak of the cross power spectrum of the Hanning windowed frames;
+ *        features matches ORB descriptors and takes the median motion of
+ *        the matches on each axis.
+ * @param current    current image
+ * @param previous   previous image
+ * @param method     how to estimate
+ * @param workspace  buffers
+ * @param offset     set to the translation rounded to whole pixels, or
+ *                   zero if there is none
+ * @return false if the method found no translation, i.e. too few features
+ *         matched
+ */
+bool global_motion(const cv::Mat &current, const cv::Mat &previous,
+                   GlobalMotionMethod method, GlobalMotionWorkspace &workspace,
+                   MotionVector &offset);
+
+#endif    // globalmotion_h
@@ -0,0 +1,72 @@
+/**
+ * @file   hexagon.cc
+ * @brief  Block Matching Algorithm: hexagon-based search
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#include "hexagon.h"
+#include "blocksearch.h"
+#include "fullsearch.h"
+#include "staticblocks.h"
+
+
+// Hexagon-based search
+MotionField hexagon_search(const cv::Mat &current, const cv::Mat &previous,
+                           int blk_size)
+{
+  MotionField mv;
+  hexagon_search(current, previous, blk_size, nullptr, mv);
+  return(mv);
+}
+
+// Hexagon-based search into existing field; serial if pool is null
+void hexagon_search(const cv::Mat &current, const cv::Mat &previous,
+                    int blk_size, ThreadPool *pool, MotionField &mv,
+                    BlockStatsField *block_stats, const SkipMap *skip)
+{
+  int blocks_wide = current.cols/blk_size;
+  int blocks_high = current.rows/blk_size;
+
+  mv.resize(blocks_wide*blocks_high);
+  if(block_stats) block_stats->resize(mv.size());
+
+  auto process_row = [&](int by)
+  {
+    for(int bx = 0; bx < blocks_wide; bx++)
+    {
+      int index = by*blocks_wide + bx;
+
+      if(is_static(skip, index))
+      {
+        mv[index] = MotionVector(0, 0);
+        if(block_stats)
+        {
+          (*block_stats)[index] = BlockStats{};
+          (*block_stats)[index].exit = EXIT_STATIC;
+        }
+        continue;
+      }
+
+      BlockSearch search(current, previous, bx*blk_size, by*blk_size,
+                         blk_size, RANGE);
+
+      search.check(0, 0);
+      hexagon_refine(search);
+      diamond_refine(search);
+
+      mv[index] = search.best();
+
+      if(block_stats)
+        set_block_stats(search, EXIT_SEARCH, PATTERN_LARGE,
+                        (*block_stats)[index]);
+    }
+  };
+
+  if(pool)
+    pool->parallel_for(blocks_high, process_row);
+  else
+  {
+    for(int by = 0; by < blocks_high; by++) process_row(by);
+  }
+}
@@ -0,0 +1,56 @@
+/**
+ * @file   hexagon.h
+ * @brief  Block Matching Algorithm: hexagon-based search
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#ifndef hexagon_h
+#define hexagon_h
+
+#include <opencv2/core.hpp>
+
+#include "threadpool.h"
+#include "blockstats.h"
+#include "motionvector.h"
+
+
+/**
+ * hexagon_search
+ * @brief Hexagon-based search,
+ *        "Hexagon-Based Search Pattern for Fast Block Motion Estimation",
+ *        2002, C. Zhu, X. Lin and L.-P. Chau, IEEE Transactions on Circuits
+ *        and Systems for Video Technology, doi 10.1109/TCSVT.2002.1003478
+ *        A large hexagon moves from the zero vector until its centre is
+ *        best, then a small diamond refines the vector. No predictors
+ *        are used, so blocks do not depend on each other, but large motion
+ *        takes many steps and the search can stop in a local minimum.
+ *        Vectors are limited to +/-RANGE.
+ * @param current    current image
+ * @param previous   previous image
+ * @param blk_size   block size
+ * @return  motion vectors
+ */
+MotionField hexagon_search(const cv::Mat &current, const cv::Mat &previous,
+                           int blk_size);
+
+/**
+ * hexagon_search
+ * @brief As above writing into an existing field, with block rows spread
+ *        across a thread pool; vectors are the same
+ * @param current    current image
+ * @param previous   previous image
+ * @param blk_size   block size
+ * @param pool       threads to use, or null to run serially
+ * @param mv         motion vectors
+ * @param block_stats  if not null, set to the SADs and pattern steps of
+ *                     each block
+ * @param skip       if not null, static blocks are given a zero vector
+ *                   without a search
+ */
+void hexagon_search(const cv::Mat &current, const cv::Mat &previous,
+                    int blk_size, ThreadPool *pool, MotionField &mv,
+                    BlockStatsField *block_stats = nullptr,
+                    const SkipMap *skip = nullptr);
+
+#endif    // hexagon_h
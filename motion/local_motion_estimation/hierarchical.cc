@@ -0,0 +1,157 @@
+/**
+ * @file   hierarchical.cc
+ * @brief  Block Matching Algorithm: hierarchical (pyramid) search
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#include <algorithm>
+
+#include <opencv2/imgproc.hpp>
+
+#include "hierarchical.h"
+#include "fullsearch.h"
+#include "bmsupport.h"
+#include "staticblocks.h"
+
+
+// Refine a vector from the level above within +/-HIER_REFINE; centre is a
+// whole number of pixels
+static MotionVector refine_block(const cv::Mat &current, const cv::Mat &previous,
+                                 int ox, int oy, int blk_size,
+                                 const MotionVector &centre)
+{
+  // Start with the zero vector so that it is preferred if all is equal
+
+  MotionVector bestvec(0, 0);
+  int bestbdm = SAD_integer(current, previous, ox, oy, ox, oy, blk_size);
+
+  int cx = ox + centre[0]/MV_UNIT;
+  int cy = oy + centre[1]/MV_UNIT;
+
+  int xmin = std::clamp(cx - HIER_REFINE, 0, previous.cols - blk_size);
+  int xmax = std::clamp(cx + HIER_REFINE, 0, previous.cols - blk_size);
+  int ymin = std::clamp(cy - HIER_REFINE, 0, previous.rows - blk_size);
+  int ymax = std::clamp(cy + HIER_REFINE, 0, previous.rows - blk_size);
+
+  for(int y = ymin; y <= ymax; y++)
+  {
+    for(int x = xmin; x <= xmax; x++)
+    {
+      int bdm = SAD_integer_bounded(current, previous, ox, oy, x, y, blk_size,
+                                    bestbdm);
+
+      if(bdm < bestbdm)
+      {
+        bestbdm = bdm;
+        bestvec = mv_pixels(x-ox, y-oy);
+      }
+    }
+  }
+
+  return(bestvec);
+}
+
+// Coarse to fine search; serial if pool is null
+void hierarchical_search(const cv::Mat &current, const cv::Mat &previous,
+                         int blk_size, int levels, ThreadPool *pool,
+                         HierarchicalWorkspace &workspace, MotionField &mv,
+                         const SkipMap *skip)
+{
+  levels = hierarchical_levels(blk_size, levels);
+
+  hierarchical_pyramid(current, levels, workspace.current);
+  hierarchical_pyramid(previous, levels, workspace.previous);
+
+  hierarchical_search(workspace.current, workspace.previous, blk_size, levels,
+                      pool, mv, skip);
+}
+
+// Build pyramid; level 0 is full resolution
+void hierarchical_pyramid(const cv::Mat &img, int levels, cv::Mat *pyramid)
+{
+  pyramid[0] = img;
+
+  for(int level = 1; level < levels; level++)
+    cv::pyrDown(pyramid[level-1], pyramid[level]);
+}
+
+// Coarse to fine search of pyramids; serial if pool is null
+void hierarchical_search(const cv::Mat *current_pyr,
+                         const cv::Mat *previous_pyr, int blk_size,
+                         int levels, ThreadPool *pool, MotionField &mv,
+                         const SkipMap *skip)
+{
+  int blocks_wide = current_pyr[0].cols/blk_size;
+  int blocks_high = current_pyr[0].rows/blk_size;
+
+  mv.resize(blocks_wide*blocks_high);
+
+  // Full search at coarsest level then refine
+
+  for(int level = levels-1; level >= 0; level--)
+  {
+    int size = blk_size >> level;
+    const cv::Mat &cur  = current_pyr[level];
+    const cv::Mat &prev = previous_pyr[level];
+
+    auto process_row = [&](int by)
+    {
+      for(int bx = 0; bx < blocks_wide; bx++)
+      {
+        MotionVector &vec = mv[by*blocks_wide + bx];
+
+        if(is_static(skip, by*blocks_wide + bx))
+          vec = MotionVector(0, 0);
+        else if(level == levels-1)
+          vec = fullsearch_block(cur, prev, bx*size, by*size, size);
+        else
+          vec = refine_block(cur, prev, bx*size, by*size, size, vec*2);
+      }
+    };
+
+    if(pool)
+      pool->parallel_for(blocks_high, process_row);
+    else
+    {
+      for(int by = 0; by < blocks_high; by++) process_row(by);
+    }
+  }
+}
+
+// Hierarchical search
+MotionField hierarchical_search(const cv::Mat &current,
+                                const cv::Mat &previous,
+                                int blk_size, int levels)
+{
+  HierarchicalWorkspace workspace;
+  MotionField mv;
+  hierarchical_search(current, previous, blk_size, levels, nullptr,
+                      workspace, mv);
+  return(mv);
+}
+
+// Hierarchical search, parallel over block rows
+MotionField hierarchical_search(const cv::Mat &current,
+                                const cv::Mat &previous,
+                                int blk_size, int levels, ThreadPool &pool)
+{
+  HierarchicalWorkspace workspace;
+  MotionField mv;
+  hierarchical_search(current, previous, blk_size, levels, &pool,
+                      workspace, mv);
+  return(mv);
+}
+
+// Number of levels
+int hierarchical_levels(int blk_size, int levels)
+{
+  levels = std::clamp(levels, 2, HIER_MAX_LEVELS);
+
+  while((levels > 1) &&
+        (((blk_size >> (levels-1)) < HIER_MIN_BLOCK) ||
+         (blk_size % (1 << (levels-1)))))
+    levels--;
+
+  return(levels);
+}
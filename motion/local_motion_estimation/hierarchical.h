@@ -0,0 +1,130 @@
+/**
+ * @file   hierarchical.h
+ * @brief  Block Matching Algorithm: hierarchical (pyramid) search
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#ifndef hierarchical_h
+#define hierarchical_h
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "threadpool.h"
+#include "motionvector.h"
+
+/// Default number of pyramid levels, including full resolution
+#define HIER_LEVELS 3
+
+/// Smallest block size used at the coarsest level
+#define HIER_MIN_BLOCK 4
+
+/// Search range for refinement at each finer level
+#define HIER_REFINE 2
+
+/// Most pyramid levels
+#define HIER_MAX_LEVELS 4
+
+
+/// Pyramids kept from frame to frame so that they are only allocated when
+/// the image size changes
+struct HierarchicalWorkspace
+{
+  cv::Mat current[HIER_MAX_LEVELS];
+  cv::Mat previous[HIER_MAX_LEVELS];
+};
+
+
+/**
+ * hierarchical_search
+ * @brief Coarse to fine block matching. Pyramids of the current and
+ *        previous images are built and each level halves the block size so
+ *        that every level has the same block grid. A full search with range
+ *        RANGE is run at the coarsest level, then vectors are doubled and
+ *        refined within +/-HIER_REFINE at each finer level; the zero vector
+ *        is also checked at every level. The effective search range is
+ *        RANGE*2^(levels-1) at a fraction of the cost of 2DFS.
+ * @param current    current image
+ * @param previous   previous image
+ * @param blk_size   block size
+ * @param levels     number of pyramid levels from 2 to 4; reduced if the
+ *                   block size at the coarsest level would be smaller than
+ *                   HIER_MIN_BLOCK
+ * @return  motion vectors
+ */
+MotionField hierarchical_search(const cv::Mat &current,
+                                const cv::Mat &previous,
+                                int blk_size, int levels = HIER_LEVELS);
+
+/**
+ * hierarchical_search
+ * @brief As above with blocks of each level spread across a thread pool
+ * @param current    current image
+ * @param previous   previous image
+ * @param blk_size   block size
+ * @param levels     number of pyramid levels from 2 to 4
+ * @param pool       threads to use
+ * @return  motion vectors
+ */
+MotionField hierarchical_search(const cv::Mat &current,
+                                const cv::Mat &previous,
+                                int blk_size, int levels, ThreadPool &pool);
+
+/**
+ * hierarchical_search
+ * @brief As above using the pyramids of a workspace and writing into an
+ *        existing field, so that nothing is allocated from frame to frame
+ * @param current    current image
+ * @param previous   previous image
+ * @param blk_size   block size
+ * @param levels     number of pyramid levels from 2 to 4
+ * @param pool       threads to use, or null to run serially
+ * @param workspace  pyramids
+ * @param mv         motion vectors
+ * @param skip       if not null, static blocks are given a zero vector
+ *                   without a search at any level
+ */
+void hierarchical_search(const cv::Mat &current, const cv::Mat &previous,
+                         int blk_size, int levels, ThreadPool *pool,
+                         HierarchicalWorkspace &workspace, MotionField &mv,
+                         const SkipMap *skip = nullptr);
+
+/**
+ * hierarchical_search
+ * @brief As above with pyramids already built by hierarchical_pyramid(),
+ *        e.g. kept with a frame that is searched more than once
+ * @param current    pyramid of current image, at least levels deep
+ * @param previous   pyramid of previous image, at least levels deep
+ * @param blk_size   block size
+ * @param levels     number of pyramid levels as given by
+ *                   hierarchical_levels()
+ * @param pool       threads to use, or null to run serially
+ * @param mv         motion vectors
+ * @param skip       if not null, static blocks are given a zero vector
+ *                   without a search at any level
+ */
+void hierarchical_search(const cv::Mat *current, const cv::Mat *previous,
+                         int blk_size, int levels, ThreadPool *pool,
+                         MotionField &mv, const SkipMap *skip = nullptr);
+
+/**
+ * Build the pyramid of an image; level 0 is the image itself and each
+ * level after it is reduced by cv::pyrDown()
+ * @param img        image
+ * @param levels     number of levels
+ * @param pyramid    array of at least levels images
+ */
+void hierarchical_pyramid(const cv::Mat &img, int levels, cv::Mat *pyramid);
+
+/**
+ * Number of pyramid levels that will be used for a block size
+ * @param blk_size   block size
+ * @param levels     requested number of levels
+ * @return  number of levels
+ */
+int hierarchical_levels(int blk_size, int levels);
+
+#endif    // hierarchical_h
+
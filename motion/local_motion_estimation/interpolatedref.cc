@@ -0,0 +1,106 @@
+/**
+ * @file   interpolatedref.cc
+ * @brief  Reference image with precomputed quarter pixel phase planes
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#include <opencv2/imgproc.hpp>
+
+#include "interpolatedref.h"
+#include "bilinear.h"
+
+
+InterpolatedReference::InterpolatedReference()
+  : padding_(0), stride_(0)
+{
+  for(int p = 0; p < 16; p++) ready_[p] = false;
+}
+
+InterpolatedReference::InterpolatedReference(const cv::Mat &image,
+                                             Phases phases, int padding)
+  : InterpolatedReference()
+{
+  build(image, phases, padding);
+}
+
+// Build phase planes
+void InterpolatedReference::build(const cv::Mat &image, Phases phases,
+                                  int padding)
+{
+  std::lock_guard<std::mutex> lock(build_mutex_);
+
+  image_   = image;
+  padding_ = padding;
+
+  // One extra row and column of border so that the right and bottom
+  // neighbours of every plane pixel can be read without bounds checks
+
+  cv::copyMakeBorder(image_, padded_, padding, padding+1, padding, padding+1,
+                     cv::BORDER_CONSTANT, 0);
+
+  for(int p = 0; p < 16; p++)
+  {
+    planes_[p].create(image_.rows + 2*padding, image_.cols + 2*padding, CV_8U);
+    ready_[p] = false;
+  }
+  stride_ = planes_[0].step;
+
+  for(int py = 0; py < 4; py++)
+  {
+    for(int px = 0; px < 4; px++)
+    {
+      if((phases == ALL_PHASES) || (((px & 1) == 0) && ((py & 1) == 0)))
+      {
+        build_plane(px, py);
+        ready_[py*4 + px] = true;
+      }
+    }
+  }
+}
+
+// Pixel of phase plane
+const unsigned char *InterpolatedReference::pixel(int x, int y,
+                                                  int px, int py) const
+{
+  int p = py*4 + px;
+
+  if(!ready_[p].load(std::memory_order_acquire))
+  {
+    std::lock_guard<std::mutex> lock(build_mutex_);
+    if(!ready_[p].load(std::memory_order_relaxed))
+    {
+      build_plane(px, py);
+      ready_[p].store(true, std::memory_order_release);
+    }
+  }
+
+  return(planes_[p].ptr<unsigned char>(y + padding_) + x + padding_);
+}
+
+// Check block lies within planes
+bool InterpolatedReference::contains(int x, int y, int wide, int high) const
+{
+  return((x >= -padding_) && (y >= -padding_) &&
+         (x + wide <= image_.cols + padding_) &&
+         (y + high <= image_.rows + padding_));
+}
+
+// Build phase plane
+void InterpolatedReference::build_plane(int px, int py) const
+{
+  // Bilinear weights in sixteenths; with quarter pixel phases the
+  // calculation in interpolate() is exact so rounding the integer sum
+  // gives the same result
+
+  const BilinearWeights &w = bilinear_weights(px, py);
+
+  cv::Mat &plane = planes_[py*4 + px];
+
+  for(int y = 0; y < plane.rows; y++)
+  {
+    bilinear_row(padded_.ptr<unsigned char>(y),
+                 padded_.ptr<unsigned char>(y+1), 1, plane.cols, w,
+                 plane.ptr<unsigned char>(y));
+  }
+}
@@ -0,0 +1,111 @@
+/**
+ * @file   interpolatedref.h
+ * @brief  Reference image with precomputed quarter pixel phase planes
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#ifndef interpolatedref_h
+#define interpolatedref_h
+
+#include <atomic>
+#include <mutex>
+#include <opencv2/core.hpp>
+
+/// Default border around each phase plane, in pixels
+#define INTERP_PADDING 16
+
+
+/**
+ * InterpolatedReference
+ * @brief Holds the 16 quarter pixel phases of a single channel image as
+ *        padded planes so that a block at a quarter pixel position can be
+ *        read as an ordinary integer aligned block. Plane (px, py) holds
+ *        the image sampled at (x + px/4, y + py/4), which is identical to
+ *        interpolate() and interpolate_block(). The border is zero, as
+ *        they treat pixels off the image as zero.
+ *
+ *        Quarter pixel planes are either all built up front or, to save
+ *        memory and time when only some phases are used, only the half
+ *        pixel planes are built up front and the rest on first use.
+ */
+class InterpolatedReference
+{
+public:
+  /// Which phase planes to build up front
+  enum Phases
+  {
+    ALL_PHASES,   ///< all 16 quarter pixel phases
+    HALF_PEL      ///< 4 half pixel phases; quarter pixel phases on demand
+  };
+
+  InterpolatedReference();
+
+  /**
+   * Build phase planes of an image
+   * @param image     input image; must be single channel uchar
+   * @param phases    which phases to build up front
+   * @param padding   border around each plane in pixels
+   */
+  explicit InterpolatedReference(const cv::Mat &image,
+                                 Phases phases = ALL_PHASES,
+                                 int padding = INTERP_PADDING);
+
+  InterpolatedReference(const InterpolatedReference &) = delete;
+  InterpolatedReference &operator=(const InterpolatedReference &) = delete;
+
+  /**
+   * Build phase planes of an image, replacing any previous image
+   * @param image     input image; must be single channel uchar
+   * @param phases    which phases to build up front
+   * @param padding   border around each plane in pixels
+   */
+  void build(const cv::Mat &image, Phases phases = ALL_PHASES,
+             int padding = INTERP_PADDING);
+
+  /**
+   * Pointer to a pixel of a phase plane, building the plane if necessary
+   * @param x         integer part of x co-ordinate; may be in the border
+   * @param y         integer part of y co-ordinate; may be in the border
+   * @param px        quarter pixel phase of x co-ordinate, 0 to 3
+   * @param py        quarter pixel phase of y co-ordinate, 0 to 3
+   * @return pointer to pixel
+   */
+  const unsigned char *pixel(int x, int y, int px, int py) const;
+
+  /**
+   * Check that a block at integer co-ordinates lies within the padded planes
+   * @param x         x co-ordinate of block origin
+   * @param y         y co-ordinate of block origin
+   * @param wide      width of block
+   * @param high      height of block
+   * @return true if block can be read from the planes
+   */
+  bool contains(int x, int y, int wide, int high) const;
+
+  /// Original image
+  const cv::Mat &image() const   { return(image_); }
+
+  /// Row stride of every plane in bytes
+  size_t stride() const          { return(stride_); }
+
+  int cols() const               { return(image_.cols); }
+  int rows() const               { return(image_.rows); }
+  int padding() const            { return(padding_); }
+
+private:
+  // Build phase plane (px, py)
+  void build_plane(int px, int py) const;
+
+  cv::Mat image_;                          // Source image
+  cv::Mat padded_;                         // Source image with zero border
+  int     padding_;
+  size_t  stride_;
+
+  mutable cv::Mat planes_[16];             // Indexed by py*4 + px
+  mutable std::atomic<bool> ready_[16];
+  mutable std::mutex build_mutex_;
+};
+
+#endif    // interpolatedref_h
+
@@ -0,0 +1,102 @@
+/**
+ * @file   motionvector.h
+ * @brief  Fixed point quarter pixel motion vectors
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#ifndef motionvector_h
+#define motionvector_h
+
+#include <cmath>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+/// Fractional bits of a motion vector component
+#define MV_FRAC_BITS 2
+
+/// Motion vector units per pixel
+#define MV_UNIT (1 << MV_FRAC_BITS)
+
+
+/// Motion vector in quarter pixels; half the size of cv::Vec2f and exact
+/// for every vector the block matching algorithms produce
+typedef cv::Vec2s MotionVector;
+
+/// Motion vectors of all blocks in raster order
+typedef std::vector<MotionVector> MotionField;
+
+/// Static block flags of all blocks in raster order; non-zero if a block
+/// barely changed from the previous frame, so was given a zero vector
+/// without being searched
+typedef std::vector<unsigned char> SkipMap;
+
+/// Search range in pixels of all blocks in raster order, for searches
+/// whose window changes from block to block
+typedef std::vector<int> RangeMap;
+
+/// Reference frame of all blocks in raster order, as the offset of its
+/// frame number from the current frame's: -1 for the previous frame, -2
+/// for the one before and +1 for the next frame
+typedef std::vector<signed char> ReferenceMap;
+
+
+/**
+ * Motion vector of a whole pixel displacement
+ * @param x         displacement in pixels
+ * @param y         displacement in pixels
+ * @return motion vector
+ */
+inline MotionVector mv_pixels(int x, int y)
+{
+  return(MotionVector(x*MV_UNIT, y*MV_UNIT));
+}
+
+/**
+ * Convert to pixels
+ * @param v         motion vector
+ * @return displacement in pixels
+ */
+inline cv::Vec2f mv_to_float(const MotionVector &v)
+{
+  return(cv::Vec2f(v[0]*(1.0f/MV_UNIT), v[1]*(1.0f/MV_UNIT)));
+}
+
+/**
+ * Convert from pixels, rounding to the nearest quarter pixel
+ * @param v         displacement in pixels
+ * @return motion vector
+ */
+inline MotionVector mv_from_float(const cv::Vec2f &v)
+{
+  return(MotionVector(cv::saturate_cast<short>(std::lround(v[0]*MV_UNIT)),
+                      cv::saturate_cast<short>(std::lround(v[1]*MV_UNIT))));
+}
+
+/**
+ * Convert field to pixels
+ * @param mv        motion vectors
+ * @return displacements in pixels
+ */
+inline std::vector<cv::Vec2f> mv_to_float(const MotionField &mv)
+{
+  std::vector<cv::Vec2f> out(mv.size());
+  for(size_t i = 0; i < mv.size(); i++) out[i] = mv_to_float(mv[i]);
+  return(out);
+}
+
+/**
+ * Convert field from pixels, rounding to the nearest quarter pixel
+ * @param mv        displacements in pixels
+ * @return motion vectors
+ */
+inline MotionField mv_from_float(const std::vector<cv::Vec2f> &mv)
+{
+  MotionField out(mv.size());
+  for(size_t i = 0; i < mv.size(); i++) out[i] = mv_from_float(mv[i]);
+  return(out);
+}
+
+#endif    // motionvector_h
+
@@ -0,0 +1,72 @@
+/**
+ * @file   multireference.cc
+ * @brief  Choose the best of several reference frames for each block
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#include "multireference.h"
+#include "staticblocks.h"
+#include "bmsupport.h"
+
+
+// Best reference of each block
+void choose_references(const cv::Mat &current,
+                       const std::vector<ReferenceField> &fields,
+                       int blk_size, ThreadPool *pool, MotionField &mv,
+                       ReferenceMap &references, SkipMap &skip)
+{
+  int blocks_wide = current.cols/blk_size;
+  int blocks_high = current.rows/blk_size;
+
+  mv.resize(blocks_wide*blocks_high);
+  references.resize(mv.size());
+
+  bool any_skip = false;
+  for(const ReferenceField &field : fields) any_skip |= (field.skip != nullptr);
+
+  if(any_skip)
+    skip.resize(mv.size());
+  else
+    skip.clear();
+
+  auto process_row = [&](int by)
+  {
+    for(int bx = 0; bx < blocks_wide; bx++)
+    {
+      int index = by*blocks_wide + bx;
+      int ox = bx*blk_size;
+      int oy = by*blk_size;
+
+      float best = 1e7;
+      size_t chosen = 0;
+
+      for(size_t r = 0; r < fields.size(); r++)
+      {
+        const MotionVector &vec = (*fields[r].mv)[index];
+
+        float error = SAD_qpel_bounded(current, *fields[r].reference, ox, oy,
+                                       ox*MV_UNIT + vec[0], oy*MV_UNIT + vec[1],
+                                       blk_size, best);
+
+        if(error < best)
+        {
+          best = error;
+          chosen = r;
+        }
+      }
+
+      mv[index]         = (*fields[chosen].mv)[index];
+      references[index] = (signed char)fields[chosen].offset;
+
+      if(any_skip) skip[index] = is_static(fields[chosen].skip, index);
+    }
+  };
+
+  if(pool)
+    pool->parallel_for(blocks_high, process_row);
+  else
+  {
+    for(int by = 0; by < blocks_high; by++) process_row(by);
+  }
+}
@@ -0,0 +1,52 @@
+/**
+ * @file   multireference.h
+ * @brief  Choose the best of several reference frames for each block
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#ifndef multireference_h
+#define multireference_h
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "interpolatedref.h"
+#include "threadpool.h"
+#include "motionvector.h"
+
+
+/// Vectors of a frame against one of its references
+struct ReferenceField
+{
+  int                          offset;     ///< frame offset of the reference;
+                                           ///< see ReferenceMap
+  const InterpolatedReference *reference;  ///< interpolated reference frame
+  const MotionField           *mv;         ///< quarter pixel vectors
+  const SkipMap               *skip;       ///< static blocks, or null
+};
+
+
+/**
+ * choose_references
+ * @brief Give each block the vector of the reference it matches best, the
+ *        one whose quarter pixel SAD at its refined vector is lowest. Ties
+ *        go to the reference listed first, so list the nearest first. Each
+ *        SAD stops once it passes the best so far, so references that do
+ *        not win cost little.
+ * @param current    current image
+ * @param fields     vectors against each reference; at least one
+ * @param blk_size   block size
+ * @param pool       threads to use, or null to run serially
+ * @param mv         set to the chosen vector of each block
+ * @param references set to the offset of the chosen reference of each block
+ * @param skip       set to the static flag of each block against its chosen
+ *                   reference; cleared if no field has static blocks
+ */
+void choose_references(const cv::Mat &current,
+                       const std::vector<ReferenceField> &fields,
+                       int blk_size, ThreadPool *pool, MotionField &mv,
+                       ReferenceMap &references, SkipMap &skip);
+
+#endif    // multireference_h
@@ -0,0 +1,278 @@
+/**
+ * @file   multisize.cc
+ * @brief  Full search at several block sizes from one pass of SADs
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#include <algorithm>
+
+#include "multisize.h"
+#include "fullsearch.h"
+#include "sadkernels.h"
+#include "staticblocks.h"
+#include "searchrange.h"
+
+/// Most block sizes of a multi-size search, 4 to 64
+static const int MAX_LEVELS = 5;
+
+
+// Whether a block size is a power of two that multi-size search supports
+static bool valid_size(int size)
+{
+  return((size >= MULTISIZE_MIN) && (size <= MULTISIZE_MAX) &&
+         !(size & (size-1)));
+}
+
+// Whether multi-size search supports a pair of block sizes
+bool multisize_supported(int min_size, int blk_size)
+{
+  return(valid_size(min_size) && valid_size(blk_size) &&
+         (min_size < blk_size));
+}
+
+/// Layout of a cost volume, which holds the candidates of one block in the
+/// windows of the largest range around the zero vector and the window
+/// centre; a block with a smaller range uses part of it
+struct VolumeLayout
+{
+  int xlo, ylo;    ///< least displacement
+  int span;        ///< candidates along each row
+  int cells;       ///< candidates in the volume
+
+  VolumeLayout(int range, MotionVector centre)
+  {
+    int cx = centre[0]/MV_UNIT;
+    int cy = centre[1]/MV_UNIT;
+
+    xlo  = std::min(cx, 0) - range;
+    ylo  = std::min(cy, 0) - range;
+    span = std::max(cx, 0) + range - xlo + 1;
+    cells = span*(std::max(cy, 0) + range - ylo + 1);
+  }
+
+  /// Offset of the cost of displacement (dx,dy)
+  int at(int dx, int dy) const { return((dy - ylo)*span + dx - xlo); }
+};
+
+// SADs of a block at every candidate of its SearchWindow. The cost of
+// candidate (x,y) is costs[layout.at(x-ox, y-oy)]; the costs of other
+// candidates are left as they were.
+static void block_costs(const cv::Mat &current, const cv::Mat &previous,
+                        int ox, int oy, int blk_size,
+                        const SearchWindow &window, const VolumeLayout &layout,
+                        sad_candidates_fn candidates, unsigned int *costs)
+{
+  // As fullsearch_block(), runs are calculated SAD_CANDIDATES at a time
+  // where there is a candidates kernel, the last group overlapping the one
+  // before
+
+  int xlimit = previous.cols - blk_size - SAD_CANDIDATES_SPAN;
+
+  const unsigned char *ref = current.ptr<unsigned char>(oy) + ox;
+  int x0[2], x1[2];
+
+  for(int y = window.top(); y <= window.bottom(); y++)
+  {
+    const unsigned char *row = previous.ptr<unsigned char>(y);
+    unsigned int *out = costs + layout.at(0, y-oy);
+    int runs = window.runs(y, x0, x1);
+
+    for(int r = 0; r < runs; r++)
+    {
+      int x = x0[r];
+      int xmax = x1[r];
+      int xlast = std::min(xmax, xlimit) - (SAD_CANDIDATES-1);
+
+      if(candidates && (xlast >= x))
+      {
+        while(x <= xlast + (SAD_CANDIDATES-1))
+        {
+          int start = std::min(x, xlast);
+          candidates(ref, current.step, row + start, previous.step,
+                     out + (start - ox));
+          x = start + SAD_CANDIDATES;
+        }
+      }
+
+      for(; x <= xmax; x++)
+        out[x - ox] = sad_block(ref, current.step, row + x, previous.step,
+                                blk_size);
+    }
+  }
+}
+
+// Costs of a block from those of its four halves, which are in raster order
+// with quarters_wide volumes between the top and bottom rows
+static void add_costs(const unsigned int *quarters, int quarters_wide,
+                      int cells, unsigned int *costs)
+{
+  const unsigned int *a = quarters;
+  const unsigned int *b = quarters + cells;
+  const unsigned int *c = quarters + quarters_wide*cells;
+  const unsigned int *d = c + cells;
+
+  for(int i = 0; i < cells; i++)
+    costs[i] = a[i] + b[i] + c[i] + d[i];
+}
+
+// Best candidate of a cost volume. Starting from the zero vector only a
+// strictly lower cost replaces the best, so as in fullsearch_block() the
+// zero vector wins a tie, otherwise the first in raster order does.
+static MotionVector best_vector(int ox, int oy, const SearchWindow &window,
+                                const VolumeLayout &layout,
+                                const unsigned int *costs)
+{
+  MotionVector bestvec(0, 0);
+  unsigned int bestbdm = costs[layout.at(0, 0)];
+  int x0[2], x1[2];
+
+  for(int y = window.top(); y <= window.bottom(); y++)
+  {
+    const unsigned int *row = costs + layout.at(0, y-oy);
+    int runs = window.runs(y, x0, x1);
+
+    for(int r = 0; r < runs; r++)
+    {
+      for(int x = x0[r]; x <= x1[r]; x++)
+      {
+        if(row[x-ox] < bestbdm)
+        {
+          bestbdm = row[x-ox];
+          bestvec = mv_pixels(x-ox, y-oy);
+        }
+      }
+    }
+  }
+
+  return(bestvec);
+}
+
+// Full search at several block sizes; serial if pool is null
+void multisize_search(const cv::Mat &current, const cv::Mat &previous,
+                      int min_size, int blk_size, ThreadPool *pool,
+                      MultiSizeWorkspace &workspace, MotionField &mv,
+                      std::vector<MotionField> &smaller,
+                      const SkipMap *skip, int range, const RangeMap *ranges,
+                      MotionVector centre)
+{
+  int blocks_wide = current.cols/blk_size;
+  int blocks_high = current.rows/blk_size;
+
+  // Level l has block size min_size << l; the last is blk_size
+
+  int levels = 1;
+  while((min_size << (levels-1)) < blk_size) levels++;
+
+  mv.resize(blocks_wide*blocks_high);
+  smaller.resize(levels-1);
+
+  for(int l = 0; l < levels-1; l++)
+  {
+    int size = min_size << l;
+    smaller[l].resize((current.cols/size)*(current.rows/size));
+  }
+
+  // One volume holds the costs of every block at every level within one
+  // block of blk_size, laid out for the largest range of any block
+
+  int largest = range;
+  if(ranges)
+    largest = ranges->empty() ? 0 :
+              *std::max_element(ranges->begin(), ranges->end());
+
+  VolumeLayout layout(largest, centre);
+
+  int offset[MAX_LEVELS];
+  int cells = 0;
+
+  for(int l = 0; l < levels; l++)
+  {
+    int n = blk_size/(min_size << l);
+    offset[l] = cells;
+    cells += n*n*layout.cells;
+  }
+
+  size_t threads = pool ? pool->size() : 1;
+  workspace.volumes.resize(threads);
+  workspace.unused.clear();
+
+  for(size_t t = 0; t < threads; t++)
+  {
+    workspace.volumes[t].resize(cells);
+    workspace.unused.push_back((int)t);
+  }
+
+  sad_candidates_fn candidates = sad_candidates_kernel(min_size);
+
+  // Each row of blocks of blk_size is written by one thread only, which
+  // holds a volume until the row is done
+
+  auto process_row = [&](int by)
+  {
+    int v;
+    {
+      std::lock_guard<std::mutex> lock(workspace.mutex);
+      v = workspace.unused.back();
+      workspace.unused.pop_back();
+    }
+
+    unsigned int *volume = workspace.volumes[v].data();
+
+    for(int bx = 0; bx < blocks_wide; bx++)
+    {
+      int ox = bx*blk_size;
+      int oy = by*blk_size;
+      bool still = is_static(skip, by*blocks_wide + bx);
+      int r = block_range(ranges, by*blocks_wide + bx, range);
+
+      for(int l = 0; l < levels; l++)
+      {
+        int size = min_size << l;
+        int n = blk_size/size;
+        int wide = current.cols/size;
+        MotionField &field = (l < levels-1) ? smaller[l] : mv;
+
+        for(int j = 0; j < n; j++)
+        {
+          for(int i = 0; i < n; i++)
+          {
+            int x = ox + i*size;
+            int y = oy + j*size;
+            MotionVector &vec = field[(y/size)*wide + x/size];
+
+            if(still)
+            {
+              vec = MotionVector(0, 0);
+              continue;
+            }
+
+            unsigned int *costs = volume + offset[l] +
+                                  (j*n + i)*layout.cells;
+
+            SearchWindow window(previous, x, y, size, r, centre);
+
+            if(l == 0)
+              block_costs(current, previous, x, y, size, window, layout,
+                          candidates, costs);
+            else
+              add_costs(volume + offset[l-1] + (2*j*2*n + 2*i)*layout.cells,
+                        2*n, layout.cells, costs);
+
+            vec = best_vector(x, y, window, layout, costs);
+          }
+        }
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(workspace.mutex);
+    workspace.unused.push_back(v);
+  };
+
+  if(pool)
+    pool->parallel_for(blocks_high, process_row);
+  else
+  {
+    for(int by = 0; by < blocks_high; by++) process_row(by);
+  }
+}
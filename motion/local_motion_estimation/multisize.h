@@ -0,0 +1,84 @@
+/**
+ * @file   multisize.h
+ * @brief  Full search at several block sizes from one pass of SADs
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#ifndef multisize_h
+#define multisize_h
+
+#include <vector>
+#include <mutex>
+
+#include <opencv2/core.hpp>
+
+#include "fullsearch.h"
+#include "threadpool.h"
+#include "motionvector.h"
+
+/// Smallest block size of a multi-size search
+#define MULTISIZE_MIN 4
+
+/// Largest block size of a multi-size search
+#define MULTISIZE_MAX 64
+
+
+/// Buffers for multi-size search, kept from frame to frame. Each thread
+/// takes a cost volume while it searches a row of blocks.
+struct MultiSizeWorkspace
+{
+  std::vector<std::vector<unsigned int>> volumes;   ///< cost volumes
+  std::vector<int>                       unused;    ///< volumes not in use
+  std::mutex                             mutex;     ///< guards unused
+};
+
+
+/**
+ * Whether multi-size search supports a pair of block sizes
+ * @param min_size   smallest block size
+ * @param blk_size   largest block size
+ * @return true if both are powers of two from MULTISIZE_MIN to
+ *         MULTISIZE_MAX and min_size is less than blk_size
+ */
+bool multisize_supported(int min_size, int blk_size);
+
+/**
+ * multisize_search
+ * @brief 2D Full Search at every power of two block size from min_size to
+ *        blk_size in one pass. For each block of the largest size the SADs
+ *        of its smallest blocks are calculated once at every candidate
+ *        within range, giving a cost volume. The costs of each larger block
+ *        are the sums of the costs of its four halves at the same
+ *        candidate, so each size after the smallest costs a few additions
+ *        per candidate rather than a search. As every candidate of a block
+ *        is also a candidate of its sub-blocks, and the best is chosen in
+ *        the same order, each field is the same as that of fullsearch() at
+ *        its block size.
+ * @param current    current image; dimensions must be multiples of blk_size
+ * @param previous   previous image
+ * @param min_size   smallest block size
+ * @param blk_size   largest block size
+ * @param pool       threads to use, or null to run serially
+ * @param workspace  buffers
+ * @param mv         motion vectors at blk_size
+ * @param smaller    motion vectors at each smaller size; smaller[i] is for
+ *                   block size min_size << i; resized as necessary
+ * @param skip       if not null, static blocks of blk_size, which are given
+ *                   a zero vector at every size without a search
+ * @param range      search range in pixels
+ * @param ranges     if not null, the search range of each block of
+ *                   blk_size in place of range, which its smaller blocks
+ *                   also use
+ * @param centre     centre of the second search window, a whole number of
+ *                   pixels; see fullsearch_block()
+ */
+void multisize_search(const cv::Mat &current, const cv::Mat &previous,
+                      int min_size, int blk_size, ThreadPool *pool,
+                      MultiSizeWorkspace &workspace, MotionField &mv,
+                      std::vector<MotionField> &smaller,
+                      const SkipMap *skip = nullptr, int range = RANGE,
+                      const RangeMap *ranges = nullptr,
+                      MotionVector centre = MotionVector(0, 0));
+
+#endif    // multisize_h
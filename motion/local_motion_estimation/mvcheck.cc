@@ -0,0 +1,329 @@
+/**
+ * @file   mvcheck.cc
+ * @brief  Check motion vector files round trip and that bad ones are refused
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "mvfile.h"
+
+/// File written and rewritten by the checks
+#define CHECK_FILENAME "temp_mvcheck.mv"
+
+/// A field as written
+struct CheckField
+{
+  MVFieldInfo            info;
+  bool                   qpel;
+  MotionField            mv;
+  std::vector<cv::Vec2f> mv_float;
+  SkipMap                skip;
+  ReferenceMap           references;
+};
+
+static int failures = 0;
+
+
+// Count and report a failed check
+static void check(bool ok, const std::string &what)
+{
+  if(!ok && (failures++ < 20)) std::cout << "  failed: " << what << "\n";
+}
+
+// Field of blocks_wide x blocks_high blocks with made up vectors and maps
+static CheckField make_field(int frame_index, int block_size, int blocks_wide,
+                             int blocks_high, bool qpel, bool skip,
+                             bool references)
+{
+  CheckField field;
+  field.info.width       = blocks_wide*block_size;
+  field.info.height      = blocks_high*block_size;
+  field.info.block_size  = block_size;
+  field.info.frame_index = frame_index;
+  field.info.algorithm   = qpel ? "2dfs" : "pmvfast";
+  field.qpel             = qpel;
+
+  size_t count = (size_t)blocks_wide*blocks_high;
+
+  for(size_t i = 0; i < count; i++)
+  {
+    int x = (int)(i*7 % 61) - 30 + frame_index;
+    int y = (int)(i*13 % 47) - 23 - frame_index;
+
+    field.mv.push_back(MotionVector(x, y));
+    field.mv_float.push_back(cv::Vec2f(x*0.25f, y*0.25f));
+
+    if(skip) field.skip.push_back((i % 3) == 0);
+    if(references) field.references.push_back(-1 - (int)(i % 4));
+  }
+
+  return(field);
+}
+
+// Write fields to CHECK_FILENAME
+static bool write_fields(const std::vector<CheckField> &fields)
+{
+  MVWriter output;
+  if(!output.open(CHECK_FILENAME)) return(false);
+
+  for(const CheckField &field : fields)
+  {
+    bool ok = field.qpel ?
+      output.write(field.info, field.mv, &field.skip, &field.references) :
+      output.write(field.info, field.mv_float, &field.skip,
+                   &field.references);
+
+    if(!ok) return(false);
+  }
+
+  return(output.close());
+}
+
+// Read CHECK_FILENAME back and compare it with the fields written
+static void check_round_trip(const std::vector<CheckField> &fields)
+{
+  check(write_fields(fields), "write fields");
+
+  MVReader input;
+  check(input.open(CHECK_FILENAME), "open written file");
+  check(!input.legacy(), "written file is not legacy");
+  check(input.frames() == (int)fields.size(), "number of fields");
+
+  for(int f = 0; f < std::min(input.frames(), (int)fields.size()); f++)
+  {
+    const CheckField &field = fields[f];
+    const MVFieldInfo &info = input.info(f);
+    std::string name = "field " + std::to_string(f);
+    size_t count = field.mv.size();
+
+    check((info.width == field.info.width) &&
+          (info.height == field.info.height) &&
+          (info.block_size == field.info.block_size) &&
+          (info.frame_index == field.info.frame_index) &&
+          (info.algorithm == field.info.algorithm) &&
+          (info.precision == (field.qpel ? MV_QPEL16 : MV_FLOAT)),
+          name + " description");
+    check(input.count(f) == count, name + " count");
+
+    if(input.count(f) != count) continue;
+
+    if(field.qpel)
+    {
+      const MotionVector *mv = input.qpel_vectors(f);
+      check(mv && !input.vectors(f), name + " quarter pixel vectors");
+      check(mv && std::equal(field.mv.begin(), field.mv.end(), mv),
+            name + " quarter pixel values");
+      check(((uintptr_t)mv % alignof(MotionVector)) == 0,
+            name + " vector alignment");
+    }
+    else
+    {
+      const cv::Vec2f *mv = input.vectors(f);
+      check(mv && !input.qpel_vectors(f), name + " float vectors");
+      check(mv && std::equal(field.mv_float.begin(), field.mv_float.end(), mv),
+            name + " float values");
+      check(((uintptr_t)mv % alignof(cv::Vec2f)) == 0,
+            name + " vector alignment");
+    }
+
+    // Either precision converts to the same quarter pixels
+
+    MotionField copy;
+    check(input.field(f, copy) && (copy == field.mv), name + " field()");
+
+    const unsigned char *skip = input.skip_map(f);
+    check(field.skip.empty() ? !skip :
+          (skip && std::equal(field.skip.begin(), field.skip.end(), skip)),
+          name + " skip map");
+
+    const signed char *references = input.reference_map(f);
+    check(field.references.empty() ? !references :
+          (references && std::equal(field.references.begin(),
+                                    field.references.end(), references)),
+          name + " reference map");
+
+    check(input.find(field.info.frame_index, field.info.block_size) <= f,
+          name + " find()");
+  }
+
+  check(input.find(-5) == -1, "find() of a missing frame");
+}
+
+// Bytes of CHECK_FILENAME
+static std::vector<char> read_file()
+{
+  std::vector<char> bytes;
+  FILE *file = fopen(CHECK_FILENAME, "rb");
+  if(!file) return(bytes);
+
+  char buffer[4096];
+  size_t got;
+  while((got = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    bytes.insert(bytes.end(), buffer, buffer + got);
+
+  fclose(file);
+  return(bytes);
+}
+
+// Write bytes to CHECK_FILENAME and check that MVReader refuses them
+static void check_refused(const std::vector<char> &bytes,
+                          const std::string &what)
+{
+  FILE *file = fopen(CHECK_FILENAME, "wb");
+  bool written = file && (fwrite(bytes.data(), 1, bytes.size(), file) ==
+                          bytes.size());
+  if(file) fclose(file);
+
+  MVReader input;
+  check(written && !input.open(CHECK_FILENAME), "refuse " + what);
+}
+
+// Corrupt a valid file in ways that must be refused
+static void check_corruption(const std::vector<CheckField> &fields)
+{
+  check(write_fields(fields), "write fields");
+  const std::vector<char> good = read_file();
+
+  MVFileHeader header;
+  std::memcpy(&header, good.data(), sizeof(header));
+  size_t index = header.index_offset;
+
+  // Truncated anywhere, including within the header
+
+  for(size_t size : { (size_t)8, (size_t)16, (size_t)24, sizeof(header),
+                      index, index + 8, good.size() - 1 })
+  {
+    std::vector<char> bytes(good.begin(), good.begin() + size);
+    check_refused(bytes, "truncated to " + std::to_string(size) + " bytes");
+  }
+
+  // Corrupt a copy of the header or of the last index entry
+
+  auto corrupt_header = [&](const std::string &what,
+                            void (*change)(MVFileHeader &, size_t))
+  {
+    std::vector<char> bytes = good;
+    MVFileHeader h;
+    std::memcpy(&h, bytes.data(), sizeof(h));
+    change(h, bytes.size());
+    std::memcpy(bytes.data(), &h, sizeof(h));
+    check_refused(bytes, what);
+  };
+
+  auto corrupt_entry = [&](const std::string &what,
+                           void (*change)(MVIndexEntry &, size_t))
+  {
+    std::vector<char> bytes = good;
+    char *last = bytes.data() + index + (fields.size()-1)*sizeof(MVIndexEntry);
+    MVIndexEntry e;
+    std::memcpy(&e, last, sizeof(e));
+    change(e, bytes.size());
+    std::memcpy(last, &e, sizeof(e));
+    check_refused(bytes, what);
+  };
+
+  corrupt_header("wrong version",
+                 [](MVFileHeader &h, size_t) { h.version++; });
+  corrupt_header("wrong entry size",
+                 [](MVFileHeader &h, size_t) { h.entry_size--; });
+  corrupt_header("index past end",
+                 [](MVFileHeader &h, size_t size) { h.index_offset = size + 64; });
+  corrupt_header("index offset overflowing",
+                 [](MVFileHeader &h, size_t) { h.index_offset = UINT64_MAX; });
+  corrupt_header("misaligned index",
+                 [](MVFileHeader &h, size_t) { h.index_offset -= 4; });
+  corrupt_header("too many fields",
+                 [](MVFileHeader &h, size_t) { h.frame_count++; });
+  corrupt_header("huge field count",
+                 [](MVFileHeader &h, size_t) { h.frame_count = UINT32_MAX; });
+
+  corrupt_entry("vectors past end",
+                [](MVIndexEntry &e, size_t size) { e.data_offset = size + 64; });
+  corrupt_entry("vector offset overflowing",
+                [](MVIndexEntry &e, size_t) { e.data_offset = UINT64_MAX - 3; });
+  corrupt_entry("misaligned vectors",
+                [](MVIndexEntry &e, size_t) { e.data_offset += 2; });
+  corrupt_entry("vectors running past end",
+                [](MVIndexEntry &e, size_t size)
+                { e.data_offset = size/MV_DATA_ALIGN*MV_DATA_ALIGN; });
+  corrupt_entry("too many blocks",
+                [](MVIndexEntry &e, size_t) { e.blocks_high = 1 << 20; });
+  corrupt_entry("huge block grid",
+                [](MVIndexEntry &e, size_t)
+                { e.blocks_wide = UINT32_MAX; e.blocks_high = UINT32_MAX; });
+  corrupt_entry("unknown precision",
+                [](MVIndexEntry &e, size_t) { e.precision = 7; });
+  corrupt_entry("maps past end",
+                [](MVIndexEntry &e, size_t size)
+                {
+                  e.flags = MV_FLAG_SKIP_MAP | MV_FLAG_REFERENCE_MAP;
+                  e.data_offset = (size - 64)/MV_DATA_ALIGN*MV_DATA_ALIGN;
+                  e.blocks_wide = 4;
+                  e.blocks_high = 1;
+                });
+
+  // The unchanged file still opens
+
+  FILE *file = fopen(CHECK_FILENAME, "wb");
+  if(file)
+  {
+    fwrite(good.data(), 1, good.size(), file);
+    fclose(file);
+  }
+
+  MVReader input;
+  check(input.open(CHECK_FILENAME) && (input.frames() == (int)fields.size()),
+        "open the file again");
+}
+
+int main()
+{
+  // Fields of several sizes and precisions, with and without each map;
+  // block grids are odd so that maps do not end on the alignment
+
+  std::vector<CheckField> fields = {
+    make_field(2,  16, 20, 12, true,  false, false),
+    make_field(2,   4, 80, 48, true,  true,  false),
+    make_field(3,  16, 20, 12, true,  true,  true),
+    make_field(3,   8,  5,  3, false, false, true),
+    make_field(4,  16,  7,  1, false, true,  false),
+    make_field(5,  32,  3,  5, true,  false, true) };
+
+  check_round_trip(fields);
+  check_round_trip(std::vector<CheckField>(1, fields[2]));
+  check_round_trip(std::vector<CheckField>());
+  check_corruption(fields);
+
+  // A raw blob of cv::Vec2f is read as a legacy field
+
+  std::vector<cv::Vec2f> raw = fields[0].mv_float;
+  FILE *file = fopen(CHECK_FILENAME, "wb");
+  if(file)
+  {
+    fwrite(raw.data(), sizeof(cv::Vec2f), raw.size(), file);
+    fclose(file);
+  }
+
+  MVReader input;
+  check(input.open(CHECK_FILENAME) && input.legacy() &&
+        (input.frames() == 1) && (input.count(0) == raw.size()),
+        "open legacy file");
+
+  input.close();
+  remove(CHECK_FILENAME);
+
+  std::cout << "Motion vector files: " << (failures ? "FAILED" : "passed");
+  if(failures) std::cout << " " << failures << " checks";
+  std::cout << "\n";
+
+  return(failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
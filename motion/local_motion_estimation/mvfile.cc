@@ -0,0 +1,356 @@
+/**
+ * @file   mvfile.cc
+ * @brief  Motion vector container file
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mvfile.h"
+
+
+MVWriter::MVWriter() : file_(nullptr), offset_(0), ok_(false)
+{
+}
+
+MVWriter::~MVWriter()
+{
+  close();
+}
+
+// Create file
+bool MVWriter::open(const std::string &filename)
+{
+  close();
+
+  file_ = fopen(filename.c_str(), "wb");
+  if(!file_) return(false);
+
+  // Header is rewritten with the index on close; until then the file has
+  // no fields rather than looking like a legacy file
+
+  MVFileHeader header = {};
+  std::memcpy(header.magic, MV_MAGIC, sizeof(header.magic));
+  header.version    = MV_VERSION;
+  header.entry_size = sizeof(MVIndexEntry);
+
+  ok_     = (fwrite(&header, sizeof(header), 1, file_) == 1);
+  offset_ = sizeof(header);
+  index_.clear();
+
+  return(ok_);
+}
+
+// Append a field of quarter pixel vectors
+bool MVWriter::write(const MVFieldInfo &info, const MotionField &mv,
+                     const SkipMap *skip, const ReferenceMap *references)
+{
+  return(write(info, MV_QPEL16, mv.data(), mv.size(), sizeof(MotionVector),
+               skip, references));
+}
+
+// Append a field of floating point vectors
+bool MVWriter::write(const MVFieldInfo &info, const std::vector<cv::Vec2f> &mv,
+                     const SkipMap *skip, const ReferenceMap *references)
+{
+  return(write(info, MV_FLOAT, mv.data(), mv.size(), sizeof(cv::Vec2f),
+               skip, references));
+}
+
+// Pad to alignment
+void MVWriter::align()
+{
+  static const char padding[MV_DATA_ALIGN] = {};
+  size_t pad = (MV_DATA_ALIGN - offset_ % MV_DATA_ALIGN) % MV_DATA_ALIGN;
+
+  if(pad) ok_ = ok_ && (fwrite(padding, 1, pad, file_) == pad);
+  offset_ += pad;
+}
+
+// Append a field
+bool MVWriter::write(const MVFieldInfo &info, MVPrecision precision,
+                     const void *data, size_t count, size_t elem_size,
+                     const SkipMap *skip, const ReferenceMap *references)
+{
+  if(!file_ || !ok_) return(false);
+
+  MVIndexEntry entry = {};
+  entry.width       = info.width;
+  entry.height      = info.height;
+  entry.block_size  = info.block_size;
+  entry.blocks_wide = (info.block_size > 0) ? info.width/info.block_size : 0;
+  entry.blocks_high = (info.block_size > 0) ? info.height/info.block_size : 0;
+  entry.frame_index = info.frame_index;
+  entry.precision   = precision;
+  strncpy(entry.algorithm, info.algorithm.c_str(), MV_ALGORITHM_LEN-1);
+
+  if((size_t)(entry.blocks_wide)*entry.blocks_high != count)
+    return(false);
+
+  if(skip && skip->empty()) skip = nullptr;
+  if(skip && (skip->size() != count)) return(false);
+
+  if(references && references->empty()) references = nullptr;
+  if(references && (references->size() != count)) return(false);
+
+  // Pad so that the vectors are aligned when the file is mapped
+
+  align();
+  entry.data_offset = offset_;
+
+  ok_ = ok_ && (fwrite(data, elem_size, count, file_) == count);
+  offset_ += count*elem_size;
+
+  if(skip)
+  {
+    align();
+    ok_ = ok_ && (fwrite(skip->data(), 1, count, file_) == count);
+    offset_ += count;
+    entry.flags |= MV_FLAG_SKIP_MAP;
+  }
+
+  if(references)
+  {
+    align();
+    ok_ = ok_ && (fwrite(references->data(), 1, count, file_) == count);
+    offset_ += count;
+    entry.flags |= MV_FLAG_REFERENCE_MAP;
+  }
+
+  index_.push_back(entry);
+
+  return(ok_);
+}
+
+// Write index and header and close
+bool MVWriter::close()
+{
+  if(!file_) return(false);
+
+  // Maps can leave the file at any length; the index must be aligned
+
+  align();
+
+  MVFileHeader header = {};
+  std::memcpy(header.magic, MV_MAGIC, sizeof(header.magic));
+  header.version      = MV_VERSION;
+  header.entry_size   = sizeof(MVIndexEntry);
+  header.frame_count  = index_.size();
+  header.index_offset = offset_;
+
+  if(!index_.empty())
+    ok_ = ok_ && (fwrite(index_.data(), sizeof(MVIndexEntry), index_.size(),
+                         file_) == index_.size());
+
+  ok_ = ok_ && (fseek(file_, 0, SEEK_SET) == 0);
+  ok_ = ok_ && (fwrite(&header, sizeof(header), 1, file_) == 1);
+  ok_ = (fclose(file_) == 0) && ok_;
+
+  file_ = nullptr;
+  index_.clear();
+
+  return(ok_);
+}
+
+
+MVReader::MVReader() : map_(nullptr), size_(0), legacy_(false)
+{
+}
+
+MVReader::~MVReader()
+{
+  close();
+}
+
+// Map file and check its header and index
+bool MVReader::open(const std::string &filename)
+{
+  close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if(fd < 0) return(false);
+
+  struct stat st;
+  if(fstat(fd, &st) || (st.st_size == 0))
+  {
+    ::close(fd);
+    return(false);
+  }
+
+  size_ = st.st_size;
+  map_  = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+
+  if(map_ == MAP_FAILED)
+  {
+    map_ = nullptr;
+    return(false);
+  }
+
+  const char *base = static_cast<const char *>(map_);
+  const MVFileHeader *header = reinterpret_cast<const MVFileHeader *>(base);
+
+  // Legacy raw blob; one field of unknown geometry
+
+  if((size_ < sizeof(header->magic)) ||
+     std::memcmp(header->magic, MV_MAGIC, sizeof(header->magic)))
+  {
+    if(size_ % sizeof(cv::Vec2f))
+    {
+      close();
+      return(false);
+    }
+
+    legacy_ = true;
+    info_.push_back(MVFieldInfo());
+    count_.push_back(size_/sizeof(cv::Vec2f));
+    data_.push_back(base);
+    skip_.push_back(nullptr);
+    references_.push_back(nullptr);
+    return(true);
+  }
+
+  // Check header and index lie within the file
+
+  if((size_ < sizeof(MVFileHeader)) ||
+     (header->version != MV_VERSION) ||
+     (header->entry_size != sizeof(MVIndexEntry)) ||
+     (header->index_offset > size_) ||
+     ((size_ - header->index_offset)/sizeof(MVIndexEntry) < header->frame_count) ||
+     (header->index_offset % alignof(MVIndexEntry)))
+  {
+    close();
+    return(false);
+  }
+
+  const MVIndexEntry *index =
+    reinterpret_cast<const MVIndexEntry *>(base + header->index_offset);
+
+  for(uint32_t f = 0; f < header->frame_count; f++)
+  {
+    const MVIndexEntry &entry = index[f];
+    size_t count = (size_t)(entry.blocks_wide)*entry.blocks_high;
+    size_t elem_size;
+
+    switch(entry.precision)
+    {
+      case MV_FLOAT:  elem_size = sizeof(cv::Vec2f);    break;
+      case MV_QPEL16: elem_size = sizeof(MotionVector); break;
+      default:        elem_size = 0;                    break;
+    }
+
+    if((elem_size == 0) ||
+       (entry.data_offset % alignof(float)) ||
+       (entry.data_offset > size_) ||
+       ((size_ - entry.data_offset)/elem_size < count))
+    {
+      close();
+      return(false);
+    }
+
+    MVFieldInfo info;
+    info.width       = entry.width;
+    info.height      = entry.height;
+    info.block_size  = entry.block_size;
+    info.frame_index = entry.frame_index;
+    info.precision   = (MVPrecision)(entry.precision);
+    info.algorithm.assign(entry.algorithm,
+                          strnlen(entry.algorithm, MV_ALGORITHM_LEN));
+
+    // Skip map follows the vectors at the next alignment, and the
+    // reference map follows whichever of them is last
+
+    const unsigned char *skip = nullptr;
+    const signed char *references = nullptr;
+    size_t end = entry.data_offset + count*elem_size;
+
+    if(entry.flags & MV_FLAG_SKIP_MAP)
+    {
+      size_t offset = (end + MV_DATA_ALIGN-1)/MV_DATA_ALIGN*MV_DATA_ALIGN;
+
+      if((offset > size_) || (size_ - offset < count))
+      {
+        close();
+        return(false);
+      }
+
+      skip = reinterpret_cast<const unsigned char *>(base + offset);
+      end  = offset + count;
+    }
+
+    if(entry.flags & MV_FLAG_REFERENCE_MAP)
+    {
+      size_t offset = (end + MV_DATA_ALIGN-1)/MV_DATA_ALIGN*MV_DATA_ALIGN;
+
+      if((offset > size_) || (size_ - offset < count))
+      {
+        close();
+        return(false);
+      }
+
+      references = reinterpret_cast<const signed char *>(base + offset);
+    }
+
+    info_.push_back(info);
+    count_.push_back(count);
+    data_.push_back(base + entry.data_offset);
+    skip_.push_back(skip);
+    references_.push_back(references);
+  }
+
+  return(true);
+}
+
+// Unmap file
+void MVReader::close()
+{
+  if(map_) munmap(map_, size_);
+
+  map_    = nullptr;
+  size_   = 0;
+  legacy_ = false;
+
+  info_.clear();
+  count_.clear();
+  data_.clear();
+  skip_.clear();
+  references_.clear();
+}
+
+// Copy a field as quarter pixel vectors
+bool MVReader::field(int frame, MotionField &mv) const
+{
+  if((frame < 0) || (frame >= frames())) return(false);
+
+  if(const MotionVector *qpel = qpel_vectors(frame))
+    mv.assign(qpel, qpel + count_[frame]);
+  else
+  {
+    const cv::Vec2f *vec = vectors(frame);
+    if(!vec) return(false);
+
+    mv.resize(count_[frame]);
+    for(size_t i = 0; i < count_[frame]; i++) mv[i] = mv_from_float(vec[i]);
+  }
+
+  return(true);
+}
+
+// Find a field by frame number
+int MVReader::find(int frame_index, int block_size) const
+{
+  for(int f = 0; f < frames(); f++)
+  {
+    if((info_[f].frame_index == frame_index) &&
+       (!block_size || (info_[f].block_size == block_size)))
+      return(f);
+  }
+
+  return(-1);
+}
+
@@ -0,0 +1,304 @@
+/**
+ * @file   mvfile.h
+ * @brief  Motion vector container file
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ *
+ * A motion vector file holds the vector fields of one or more frames.
+ * Layout, all values in host (little endian) byte order:
+ *
+ *   MVFileHeader                  at offset 0
+ *   vector field of each frame    each at a multiple of MV_DATA_ALIGN,
+ *                                 followed by its skip map, if it has one,
+ *                                 at the next multiple of MV_DATA_ALIGN,
+ *                                 then its reference map, if it has one,
+ *                                 at the multiple after that
+ *   MVIndexEntry per frame        at MVFileHeader::index_offset, a multiple
+ *                                 of MV_DATA_ALIGN
+ *
+ * Each index entry describes one field and gives the offset of its vectors
+ * so that a field can be used straight from a memory mapping of the file.
+ * Vectors are stored either as MotionVectors in quarter pixels or as
+ * cv::Vec2f in pixels. A skip map has one byte per block, non-zero if the
+ * block was static; readers that do not know of skip maps ignore the flag
+ * and the bytes after the vectors. A reference map, written when each
+ * block may be matched against a different frame, has one signed byte per
+ * block, the offset of the block's reference frame from the current frame
+ * (-1 for the previous frame); a field without one is against the previous
+ * frame. Files without the header are legacy raw blobs of cv::Vec2f, as
+ * written by save_vectors(), and are read as a single field of unknown
+ * geometry.
+ */
+
+#ifndef mvfile_h
+#define mvfile_h
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "motionvector.h"
+
+/// File identifier
+#define MV_MAGIC "BMAV"
+
+/// Format version
+#define MV_VERSION 1
+
+/// Alignment of each field's vectors within the file, in bytes
+#define MV_DATA_ALIGN 64
+
+/// Maximum length of algorithm name including terminator
+#define MV_ALGORITHM_LEN 24
+
+/// The field is followed by a skip map
+#define MV_FLAG_SKIP_MAP 1
+
+/// The field is followed by a reference map
+#define MV_FLAG_REFERENCE_MAP 2
+
+/// How vectors are stored
+enum MVPrecision
+{
+  MV_FLOAT = 0,   ///< cv::Vec2f in pixels
+  MV_QPEL16 = 1   ///< MotionVector, int16 in quarter pixels
+};
+
+/// File header
+struct MVFileHeader
+{
+  char     magic[4];          ///< MV_MAGIC, not terminated
+  uint16_t version;           ///< MV_VERSION
+  uint16_t entry_size;        ///< sizeof(MVIndexEntry)
+  uint32_t frame_count;       ///< number of fields
+  uint32_t reserved;
+  uint64_t index_offset;      ///< offset of the index from start of file
+  uint64_t reserved2;
+};
+
+/// Index entry describing one field
+struct MVIndexEntry
+{
+  uint64_t data_offset;       ///< offset of vectors from start of file
+  uint32_t width;             ///< image width in pixels
+  uint32_t height;            ///< image height in pixels
+  uint32_t block_size;
+  uint32_t blocks_wide;
+  uint32_t blocks_high;
+  int32_t  frame_index;       ///< frame number of current frame, or 0
+  uint16_t precision;         ///< MVPrecision
+  uint16_t flags;             ///< MV_FLAG_ bits, zero in older files
+  uint32_t reserved2;
+  char     algorithm[MV_ALGORITHM_LEN];   ///< terminated algorithm name
+};
+
+static_assert(sizeof(MVFileHeader) == 32, "MVFileHeader layout");
+static_assert(sizeof(MVIndexEntry) == 64, "MVIndexEntry layout");
+
+/// Description of a field
+struct MVFieldInfo
+{
+  int         width       = 0;   ///< image width, 0 if unknown
+  int         height      = 0;   ///< image height, 0 if unknown
+  int         block_size  = 0;   ///< 0 if unknown
+  int         frame_index = 0;   ///< frame number of current frame, or 0
+  MVPrecision precision   = MV_FLOAT;   ///< set by MVReader; MVWriter
+                                        ///< ignores it
+  std::string algorithm;
+};
+
+
+/**
+ * MVWriter
+ * @brief Writes vector fields to a motion vector file one frame at a time;
+ *        the index is written when the file is closed.
+ */
+class MVWriter
+{
+public:
+  MVWriter();
+  ~MVWriter();
+
+  MVWriter(const MVWriter &) = delete;
+  MVWriter &operator=(const MVWriter &) = delete;
+
+  /**
+   * Create file, replacing any existing file
+   * @param filename    name of file
+   * @return true if success
+   */
+  bool open(const std::string &filename);
+
+  /**
+   * Append a field of quarter pixel vectors
+   * @param info        description of field; its block grid must match mv
+   * @param mv          vectors in raster order of blocks
+   * @param skip        if not null and not empty, static blocks of the
+   *                    field, written after the vectors
+   * @param references  if not null and not empty, reference frame of each
+   *                    block, written after the skip map
+   * @return true if success
+   */
+  bool write(const MVFieldInfo &info, const MotionField &mv,
+             const SkipMap *skip = nullptr,
+             const ReferenceMap *references = nullptr);
+
+  /**
+   * Append a field of floating point vectors
+   * @param info        description of field; its block grid must match mv
+   * @param mv          vectors in raster order of blocks
+   * @param skip        if not null and not empty, static blocks of the
+   *                    field, written after the vectors
+   * @param references  if not null and not empty, reference frame of each
+   *                    block, written after the skip map
+   * @return true if success
+   */
+  bool write(const MVFieldInfo &info, const std::vector<cv::Vec2f> &mv,
+             const SkipMap *skip = nullptr,
+             const ReferenceMap *references = nullptr);
+
+  /**
+   * Write index and header and close the file; also done on destruction
+   * @return true if success
+   */
+  bool close();
+
+private:
+  // Append a field of count vectors of elem_size bytes
+  bool write(const MVFieldInfo &info, MVPrecision precision,
+             const void *data, size_t count, size_t elem_size,
+             const SkipMap *skip, const ReferenceMap *references);
+
+  // Pad file to a multiple of MV_DATA_ALIGN
+  void align();
+
+  FILE                     *file_;
+  uint64_t                  offset_;
+  std::vector<MVIndexEntry> index_;
+  bool                      ok_;
+};
+
+
+/**
+ * MVReader
+ * @brief Memory maps a motion vector file, in this format or the legacy
+ *        raw format, and gives access to its fields without copying.
+ */
+class MVReader
+{
+public:
+  MVReader();
+  ~MVReader();
+
+  MVReader(const MVReader &) = delete;
+  MVReader &operator=(const MVReader &) = delete;
+
+  /**
+   * Map file and check its header and index
+   * @param filename    name of file
+   * @return true if success
+   */
+  bool open(const std::string &filename);
+
+  /// Unmap file
+  void close();
+
+  /// Number of fields
+  int frames() const { return((int)info_.size()); }
+
+  /// True if the file is a legacy raw blob
+  bool legacy() const { return(legacy_); }
+
+  /**
+   * Description of a field
+   * @param frame       field number, 0 to frames()-1
+   * @return description
+   */
+  const MVFieldInfo &info(int frame) const { return(info_[frame]); }
+
+  /**
+   * Number of vectors in a field
+   * @param frame       field number
+   * @return number of vectors
+   */
+  size_t count(int frame) const { return(count_[frame]); }
+
+  /**
+   * Floating point vectors of a field, valid until the file is closed
+   * @param frame       field number
+   * @return pointer to count(frame) vectors in the mapping, or null if the
+   *         field is not stored as MV_FLOAT
+   */
+  const cv::Vec2f *vectors(int frame) const
+  {
+    return((info_[frame].precision == MV_FLOAT) ?
+           static_cast<const cv::Vec2f *>(data_[frame]) : nullptr);
+  }
+
+  /**
+   * Quarter pixel vectors of a field, valid until the file is closed
+   * @param frame       field number
+   * @return pointer to count(frame) vectors in the mapping, or null if the
+   *         field is not stored as MV_QPEL16
+   */
+  const MotionVector *qpel_vectors(int frame) const
+  {
+    return((info_[frame].precision == MV_QPEL16) ?
+           static_cast<const MotionVector *>(data_[frame]) : nullptr);
+  }
+
+  /**
+   * Skip map of a field, valid until the file is closed
+   * @param frame       field number
+   * @return pointer to count(frame) flags in the mapping, or null if the
+   *         field has no skip map
+   */
+  const unsigned char *skip_map(int frame) const { return(skip_[frame]); }
+
+  /**
+   * Reference map of a field, valid until the file is closed
+   * @param frame       field number
+   * @return pointer to count(frame) frame offsets in the mapping, or null
+   *         if the field has no reference map, i.e. every block is against
+   *         the previous frame
+   */
+  const signed char *reference_map(int frame) const
+  {
+    return(references_[frame]);
+  }
+
+  /**
+   * Copy a field as quarter pixel vectors, whatever its precision;
+   * floating point vectors are rounded to the nearest quarter pixel
+   * @param frame       field number
+   * @param mv          vectors of field
+   * @return true if success
+   */
+  bool field(int frame, MotionField &mv) const;
+
+  /**
+   * Find a field by frame number
+   * @param frame_index frame number of current frame
+   * @param block_size  block size of the field, or 0 for the first field of
+   *                    the frame whatever its block size
+   * @return field number or -1 if not found
+   */
+  int find(int frame_index, int block_size = 0) const;
+
+private:
+  void   *map_;
+  size_t  size_;
+  bool    legacy_;
+
+  std::vector<MVFieldInfo>       info_;
+  std::vector<size_t>            count_;
+  std::vector<const void *>      data_;
+  std::vector<const unsigned char *> skip_;
+  std::vector<const signed char *>   references_;
+};
+
+#endif    // mvfile_h
+
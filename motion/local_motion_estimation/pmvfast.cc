@@ -7,167 +7,370 @@
 
 #include <iostream>
 #include <algorithm>
-#include <numeric>
 
 #include "pmvfast.h"
 #include "bmsupport.h"
+#include "blocksearch.h"
+#include "staticblocks.h"
 
 
 // Check that location (sx, sy) is valid for a block within the image bounds
-bool is_valid(float sx, float sy, int blk_size, const cv::Mat &img);
+bool is_valid(int sx, int sy, int blk_size, const cv::Mat &img);
 
-// pmvfast
-std::vector<cv::Vec2f> pmvfast(const cv::Mat &current, const cv::Mat &previous,
-                               int blk_size)
+// PMVFAST thresholds
+struct PMVFASTThresholds
+{
+  int   K;               // See section 4, paragraph 3 of paper for value of K
+  int   med_vec_stop;
+  float T1_min;
+  float T1_max;
+  int   T2_offset;
+  int   no_predictor;    // minimum SAD before any predictor is checked
+};
+
+// Get thresholds for block size. The paper gives them for 16x16 blocks;
+// as they bound a SAD they are scaled by block area. The starting minimum
+// SAD is never less than the original 10000, so that 8x8 and 16x16 are
+// unchanged, but grows with area so that larger blocks still take their
+// best predictor.
+static constexpr PMVFASTThresholds pmvfast_thresholds(int blk_size)
+{
+  int area = blk_size*blk_size;
+
+  PMVFASTThresholds t = { 1536*area/256, 256*area/256,
+                          512.0f*area/256, 1024.0f*area/256,
+                          256*area/256, 10000*std::max(area, 256)/256 };
+  return(t);
+}
+
+static_assert(pmvfast_thresholds(16).K == 1536 &&
+              pmvfast_thresholds(8).K == 384 &&
+              pmvfast_thresholds(8).med_vec_stop == 64,
+              "PMVFAST thresholds must match the paper at 16x16 and 8x8");
+
+// Block size of a kernel that is fixed at compile time, or the runtime
+// block size if N is 0
+template<int N>
+static inline int block_size(int blk_size)
+{
+  return(N ? N : blk_size);
+}
+
+// Bounded integer SAD using the fixed size kernel if there is one, counted
+// in stats if not null
+template<int N>
+static inline int block_sad(const cv::Mat &current, const cv::Mat &previous,
+                            int ox, int oy, int sx, int sy, int blk_size,
+                            int bound, BlockStats *stats)
+{
+  if(stats) stats->sads++;
+
+  if constexpr(N != 0)
+    return(SAD_integer_bounded<N>(current, previous, ox, oy, sx, sy, bound));
+  else
+    return(SAD_integer_bounded(current, previous, ox, oy, sx, sy, blk_size,
+                               bound));
+}
+
+template<int N>
+static void large_diamond(const cv::Mat &current, const cv::Mat &previous,
+                          int blockx, int blocky, int blk_size,
+                          MotionField &mv, BlockStats *stats);
+
+template<int N>
+static void small_diamond(const cv::Mat &current, const cv::Mat &previous,
+                          int blockx, int blocky, int blk_size,
+                          MotionField &mv, BlockStats *stats);
+
+// Count how a block finished
+static void count_exit(PMVFASTStats &stats, BlockExit exit)
+{
+  stats.blocks++;
+  if(exit == EXIT_MEDIAN)   stats.median_stops++;
+  if(exit == EXIT_TEMPORAL) stats.temporal_stops++;
+}
+
+// Add statistics
+static void add_stats(PMVFASTStats &total, const PMVFASTStats &stats)
+{
+  total.blocks         += stats.blocks;
+  total.median_stops   += stats.median_stops;
+  total.temporal_stops += stats.temporal_stops;
+}
+
+// Estimate motion of one block; the left, top and top right blocks must
+// already have been estimated. previous_field, if not null, is the field of
+// the previous frame with the same block grid, and global, if not null, the
+// global motion of the frame. N is the block size if it is fixed at compile
+// time, otherwise 0 and blk_size is used. If stats is not null SADs, diamond
+// steps and the diamond used are counted in it.
+template<int N>
+static BlockExit pmvfast_block(const cv::Mat &current,
+                               const cv::Mat &previous,
+                               int bx, int by, int blk_size,
+                               const MotionField *previous_field,
+                               const MotionVector *global,
+                               MotionField &motion, BlockStats *stats)
 {
+  blk_size = block_size<N>(blk_size);
+  const PMVFASTThresholds th = pmvfast_thresholds(blk_size);
+
   int blocks_wide = current.cols/blk_size;
   int blocks_high = current.rows/blk_size;
 
-  std::vector<cv::Vec2f> motion(blocks_wide*blocks_high);
-
-  int medx, medy;
+  int medx, medy;                // median in pixels
   float min_sad;
   int T1, T2;
 
-  int K = 1536;            // See section 4, paragraph 3 of paper for value of K
-  int med_vec_stop = 256;
-  float T1_min  = 512.0;
-  float T1_max  = 1024.0;
-  int T2_offset = 256;
-
-  if(blk_size == 8) {
-    K = 384;
-    med_vec_stop = 64;
-    T1_min = 128;
-    T1_max = 256;
-    T2_offset = 64;
-  }
+  int ox = bx*blk_size;
+  int oy = by*blk_size;
 
-  // Main algorithm
+  // 1. Check SAD of median vector; if less than 256 then stop
+  //    Spatial predictors are left, top and top right blocks
 
-  for(int by = 0; by < blocks_high; by++)
+  MotionVector predictors[7];
+  int count = spatial_predictors(motion, bx, by, blocks_wide, predictors);
+
+  MotionVector median = median_predictor(predictors, count);
+  medx = median[0]/MV_UNIT;
+  medy = median[1]/MV_UNIT;
+
+  // Check median vector is valid
+
+  if(is_valid(ox+medx, oy+medy, blk_size, previous))
   {
-    for(int bx = 0; bx < blocks_wide; bx++)
+    float med_sad = block_sad<N>(current, previous, ox, oy,
+                                 ox+medx, oy+medy, blk_size, th.med_vec_stop,
+                                 stats);
+    if(med_sad < th.med_vec_stop)
     {
-      int ox = bx*blk_size;
-      int oy = by*blk_size;
-
-      // 1. Check SAD of median vector; if less than 256 then stop
-      //    Predictors are left, top and top right blocks
-
-      std::vector<cv::Vec2f> predictors;
-      if(bx > 0) predictors.push_back(motion[by*blocks_wide + (bx-1)]);
-      if(by > 0) {
-        predictors.push_back(motion[(by-1)*blocks_wide + bx]);
-        if(bx < blocks_wide-1)
-          predictors.push_back(motion[(by-1)*blocks_wide + (bx+1)]);
-      }
+      // Early termination
+      motion[by*blocks_wide + bx] = mv_pixels(medx, medy);
+      return(EXIT_MEDIAN);
+    }
+  }
 
-      switch(predictors.size())
-      {
-        case 0:
-        medx = 0; medy = 0;
-        break;
-
-        case 1:
-        medx = predictors[0][0]; medy = predictors[0][1];
-        break;
-
-        case 2:
-        medx = (predictors[0][0] + predictors[1][0])/2;
-        medy = (predictors[0][1] + predictors[1][1])/2;
-        break;
-
-        default:
-        std::vector<float> px, py;
-        for(auto v : predictors)
-        {
-          px.push_back(v[0]);
-          py.push_back(v[1]);
-        }
-        std::sort(px.begin(), px.end());
-        std::sort(py.begin(), py.end());
-        medx = px[px.size()/2];
-        medy = py[py.size()/2];
-      }
+  // 1a. Temporal predictors are the co-located vector of the previous field
+  //     and the vectors right of and below it, which are not yet available
+  //     in the current field. Stop if the co-located vector is as good as
+  //     the median would have to be.
 
-      // Check median vector is valid
+  if(previous_field)
+  {
+    const MotionVector &colocated = (*previous_field)[by*blocks_wide + bx];
+    int colx = colocated[0]/MV_UNIT;
+    int coly = colocated[1]/MV_UNIT;
 
-      if(is_valid(ox+medx, oy+medy, blk_size, previous))
+    if(((colx != medx) || (coly != medy)) &&
+       is_valid(ox+colx, oy+coly, blk_size, previous))
+    {
+      float col_sad = block_sad<N>(current, previous, ox, oy,
+                                   ox+colx, oy+coly, blk_size,
+                                   th.med_vec_stop, stats);
+      if(col_sad < th.med_vec_stop)
       {
-        float med_sad = SAD(current, previous, ox, oy,
-                            ox+medx, oy+medy, blk_size);
-        if(med_sad < med_vec_stop)
-        {
-          // Early termination
-          motion[by*blocks_wide + bx] = cv::Vec2f(medx, medy);
-          continue;
-        }
+        motion[by*blocks_wide + bx] = colocated;
+        return(EXIT_TEMPORAL);
       }
+    }
 
-      // 2. Calculate minimum SAD of predictors
+    predictors[count++] = colocated;
+    if(bx < blocks_wide-1)
+      predictors[count++] = (*previous_field)[by*blocks_wide + (bx+1)];
+    if(by < blocks_high-1)
+      predictors[count++] = (*previous_field)[(by+1)*blocks_wide + bx];
+  }
 
-      cv::Vec2f best_predictor;
-      min_sad = 10000;
+  // 1b. The global motion is a predictor for every block, so that blocks
+  //     without neighbours start from it too
 
-      for(int p = 0; p < predictors.size(); p++)
-      {
-        if(is_valid(ox+predictors[p][0], oy+predictors[p][1], blk_size, previous))
-        {
-          float pred_sad = SAD(current, previous, ox, oy,
-                               ox+predictors[p][0], oy+predictors[p][1], blk_size);
-
-          if(pred_sad < min_sad) {
-            best_predictor = predictors[p];
-            min_sad = pred_sad;
-          }
-        }
-      }
+  if(global) predictors[count++] = *global;
 
-      T1 = std::clamp(min_sad, T1_min, T1_max);   // See section 4, paragraph 1
-      T2 = min_sad + T2_offset;                   // Section 4, paragraph 3
+  // 2. Calculate minimum SAD of predictors
 
-      // Best predictor is used as centre of search in next step
-      motion[by*blocks_wide + bx] = best_predictor;
+  MotionVector best_predictor;
+  min_sad = th.no_predictor;
 
-      // 3. Check predictors to decide search type:
-      //    Calculate magnitude of median vector = magmed
-      //     If magmed = 0 and T2 is large then use large diamond search,
-      //     else use small diamond
-      bool use_small_diamond = false;
+  for(int p = 0; p < count; p++)
+  {
+    int px = predictors[p][0]/MV_UNIT;
+    int py = predictors[p][1]/MV_UNIT;
 
-      float magmed = sqrt((medx*medx)+(medy*medy));
+    if(is_valid(ox+px, oy+py, blk_size, previous))
+    {
+      float pred_sad = block_sad<N>(current, previous, ox, oy,
+                                    ox+px, oy+py, blk_size, min_sad, stats);
 
-      if((magmed < 0.1) && (T2 < K)) {
-        use_small_diamond = true;
+      if(pred_sad < min_sad) {
+        best_predictor = predictors[p];
+        min_sad = pred_sad;
       }
-
-      // 4. Diamond search from best predictor
-      if(use_small_diamond)
-        small_diamond_search(current, previous, bx, by, blk_size, motion);
-      else
-        large_diamond_search(current, previous, bx, by, blk_size, motion);
     }
   }
 
+  T1 = std::clamp(min_sad, th.T1_min, th.T1_max);   // See section 4, paragraph 1
+  T2 = min_sad + th.T2_offset;                      // Section 4, paragraph 3
+
+  // Best predictor is used as centre of search in next step
+  motion[by*blocks_wide + bx] = best_predictor;
+
+  // 3. Check predictors to decide search type:
+  //    If the median vector is zero and T2 is small then use small diamond
+  //    search, else use large diamond
+  bool use_small_diamond = false;
+
+  if((medx == 0) && (medy == 0) && (T2 < th.K)) {
+    use_small_diamond = true;
+  }
+
+  // 4. Diamond search from best predictor
+  if(stats) stats->pattern = use_small_diamond ? PATTERN_SMALL : PATTERN_LARGE;
+
+  if(use_small_diamond)
+    small_diamond<N>(current, previous, bx, by, blk_size, motion, stats);
+  else
+    large_diamond<N>(current, previous, bx, by, blk_size, motion, stats);
+
+  return(EXIT_SEARCH);
+}
+
+// Estimation of one block
+typedef BlockExit (*pmvfast_block_fn)(const cv::Mat &, const cv::Mat &,
+                                      int, int, int, const MotionField *,
+                                      const MotionVector *, MotionField &,
+                                      BlockStats *);
+
+// Get block estimation specialised for block size, or the general one
+static pmvfast_block_fn pmvfast_block_for(int blk_size)
+{
+  switch(blk_size)
+  {
+    case 4:  return(pmvfast_block<4>);
+    case 8:  return(pmvfast_block<8>);
+    case 16: return(pmvfast_block<16>);
+    case 32: return(pmvfast_block<32>);
+    case 64: return(pmvfast_block<64>);
+  }
+
+  return(pmvfast_block<0>);
+}
+
+// pmvfast
+MotionField pmvfast(const cv::Mat &current, const cv::Mat &previous,
+                    int blk_size, const MotionField *previous_field,
+                    PMVFASTStats *stats)
+{
+  PMVFASTWorkspace workspace;
+  MotionField motion;
+  pmvfast(current, previous, blk_size, nullptr, previous_field, workspace,
+          motion, stats);
+  return(motion);
+}
+
+// pmvfast, wavefront parallel
+MotionField pmvfast(const cv::Mat &current, const cv::Mat &previous,
+                    int blk_size, ThreadPool &pool,
+                    const MotionField *previous_field, PMVFASTStats *stats)
+{
+  PMVFASTWorkspace workspace;
+  MotionField motion;
+  pmvfast(current, previous, blk_size, &pool, previous_field, workspace,
+          motion, stats);
   return(motion);
 }
 
+// pmvfast with workspace; serial if pool is null, otherwise a wavefront in
+// which each block row runs two blocks behind the row above
+void pmvfast(const cv::Mat &current, const cv::Mat &previous, int blk_size,
+             ThreadPool *pool, const MotionField *previous_field,
+             PMVFASTWorkspace &workspace, MotionField &motion,
+             PMVFASTStats *stats, BlockStatsField *block_stats,
+             const SkipMap *skip, const MotionVector *global)
+{
+  int blocks_wide = current.cols/blk_size;
+  int blocks_high = current.rows/blk_size;
+
+  motion.resize(blocks_wide*blocks_high);
+  pmvfast_block_fn estimate_block = pmvfast_block_for(blk_size);
+
+  std::vector<PMVFASTStats> &row_stats = workspace.row_stats;
+  row_stats.assign(blocks_high, PMVFASTStats());
+
+  if(previous_field && (previous_field->size() != motion.size()))
+    previous_field = nullptr;
+
+  if(block_stats) block_stats->assign(motion.size(), BlockStats());
+
+  auto process_block = [&](int bx, int by)
+  {
+    int index = by*blocks_wide + bx;
+    BlockStats *bs = block_stats ? &(*block_stats)[index] : nullptr;
+
+    if(is_static(skip, index))
+    {
+      motion[index] = MotionVector(0, 0);
+      if(bs) bs->exit = EXIT_STATIC;
+      return;
+    }
+
+    BlockExit exit = estimate_block(current, previous, bx, by, blk_size,
+                                    previous_field, global, motion, bs);
+    count_exit(row_stats[by], exit);
+    if(bs) bs->exit = exit;
+  };
+
+  run_wavefront(blocks_wide, blocks_high, pool, workspace.wavefront,
+                process_block);
+
+  if(stats)
+  {
+    for(const PMVFASTStats &r : row_stats) add_stats(*stats, r);
+  }
+}
+
+// Large diamond search
 void large_diamond_search(const cv::Mat &current, const cv::Mat &previous,
                           int blockx, int blocky, int blk_size,
-                          std::vector<cv::Vec2f> &mv)
+                          MotionField &mv)
+{
+  large_diamond<0>(current, previous, blockx, blocky, blk_size, mv, nullptr);
+}
+
+// Small diamond search
+void small_diamond_search(const cv::Mat &current, const cv::Mat &previous,
+                          int blockx, int blocky, int blk_size,
+                          MotionField &mv)
 {
+  small_diamond<0>(current, previous, blockx, blocky, blk_size, mv, nullptr);
+}
+
+// Large diamond search for block size N, or blk_size if N is 0; positions
+// and SADs are counted in stats if not null
+template<int N>
+static void large_diamond(const cv::Mat &current, const cv::Mat &previous,
+                          int blockx, int blocky, int blk_size,
+                          MotionField &mv, BlockStats *stats)
+{
+  blk_size = block_size<N>(blk_size);
+
   int blocks_wide = current.cols/blk_size;
   int ox = blockx*blk_size;
   int oy = blocky*blk_size;
   int mv_block_index = blocky*blocks_wide + blockx;
 
   // We keep a list of which candidate positions to check because when the
-  // search pattern moves we only need to calculate new positions.
+  // search pattern moves we only need to calculate new positions: those to
+  // check first and after moving to each position.
+
+  static const int first[9]    = { 0, 1, 2, 3, 4, 5, 6, 7, 8 };
+  static const int next[9][5]  = { {}, {4,8,1,5,2}, {1,5,2,6,3}, {2,6,3,7,4},
+                                   {3,7,4,8,1}, {1,5,2}, {2,6,3}, {3,7,4},
+                                   {4,8,1} };
+  static const int next_count[9] = { 0, 5, 5, 5, 5, 3, 3, 3, 3 };
 
-  std::vector<cv::Vec2f> search_mv(9);
-  std::vector<int> candidate_pos(9);
-  std::iota(candidate_pos.begin(), candidate_pos.end(), 0);
+  MotionVector search_mv[9];
+  const int *candidate_pos = first;
+  int candidates = 9;
 
   float best_sad = 1e7;
   int   best_mv_pos = 0;
@@ -175,26 +378,31 @@ void large_diamond_search(const cv::Mat &current, const cv::Mat &previous,
 
   while(process)
   {
-    cv::Vec2f centre_mv = mv[mv_block_index];
+    if(stats) stats->steps++;
+
+    MotionVector centre_mv = mv[mv_block_index];
     search_mv[0] = centre_mv;
-    search_mv[1] = centre_mv; search_mv[1][1] -= 2;  // up
-    search_mv[2] = centre_mv; search_mv[2][0] += 2;  // right
-    search_mv[3] = centre_mv; search_mv[3][1] += 2;  // down
-    search_mv[4] = centre_mv; search_mv[4][0] -= 2;  // left
-    search_mv[5] = centre_mv; search_mv[5][0]++; search_mv[5][1]--; // right-up
-    search_mv[6] = centre_mv; search_mv[6][0]++; search_mv[6][1]++; // right-down
-    search_mv[7] = centre_mv; search_mv[7][0]--; search_mv[7][1]++; // left-down
-    search_mv[8] = centre_mv; search_mv[8][0]--; search_mv[8][1]--; // left-up
+    search_mv[1] = centre_mv + mv_pixels( 0, -2);   // up
+    search_mv[2] = centre_mv + mv_pixels( 2,  0);   // right
+    search_mv[3] = centre_mv + mv_pixels( 0,  2);   // down
+    search_mv[4] = centre_mv + mv_pixels(-2,  0);   // left
+    search_mv[5] = centre_mv + mv_pixels( 1, -1);   // right-up
+    search_mv[6] = centre_mv + mv_pixels( 1,  1);   // right-down
+    search_mv[7] = centre_mv + mv_pixels(-1,  1);   // left-down
+    search_mv[8] = centre_mv + mv_pixels(-1, -1);   // left-up
 
     // Get SAD for each candidate
 
-    for(int cand_no : candidate_pos)
+    for(int c = 0; c < candidates; c++)
     {
-      if(is_valid(ox+search_mv[cand_no][0], oy+search_mv[cand_no][1], blk_size, previous))
+      int cand_no = candidate_pos[c];
+      int sx = ox + search_mv[cand_no][0]/MV_UNIT;
+      int sy = oy + search_mv[cand_no][1]/MV_UNIT;
+
+      if(is_valid(sx, sy, blk_size, previous))
       {
-        float bdm = SAD(current, previous, ox, oy,
-                        ox+search_mv[cand_no][0], oy+search_mv[cand_no][1],
-                        blk_size);
+        float bdm = block_sad<N>(current, previous, ox, oy, sx, sy,
+                                 blk_size, best_sad, stats);
 
         if(bdm < best_sad) {
           best_mv_pos = cand_no;
@@ -203,69 +411,42 @@ void large_diamond_search(const cv::Mat &current, const cv::Mat &previous,
       }
     }
 
-    // Update next candidate search positions
-
-    candidate_pos.clear();
-
-    switch(best_mv_pos)
-    {
-      case 0:  // centre
-      process = false;
-      break;
-
-      case 1:  // move up
-      candidate_pos.assign({4,8,1,5,2});
-      break;
-
-      case 2:  // move right
-      candidate_pos.assign({1,5,2,6,3});
-      break;
-
-      case 3:  // move down
-      candidate_pos.assign({2,6,3,7,4});
-      break;
-
-      case 4:  // move left
-      candidate_pos.assign({3,7,4,8,1});
-      break;
-
-      case 5:  // move up-right
-      candidate_pos.assign({1,5,2});
-      break;
+    // Update next candidate search positions; stop at the centre
 
-      case 6:  // move down-right
-      candidate_pos.assign({2,6,3});
-      break;
-
-      case 7:  // move down-left
-      candidate_pos.assign({3,7,4});
-      break;
-
-      case 8:  // move up-left
-      candidate_pos.assign({4,8,1});
-      break;
-    }
+    candidate_pos = next[best_mv_pos];
+    candidates    = next_count[best_mv_pos];
+    process       = (best_mv_pos != 0);
 
     if(process) mv[mv_block_index] = search_mv[best_mv_pos];
     best_mv_pos = 0;
   }
 }
 
-void small_diamond_search(const cv::Mat &current, const cv::Mat &previous,
+// Small diamond search for block size N, or blk_size if N is 0; positions
+// and SADs are counted in stats if not null
+template<int N>
+static void small_diamond(const cv::Mat &current, const cv::Mat &previous,
                           int blockx, int blocky, int blk_size,
-                          std::vector<cv::Vec2f> &mv)
+                          MotionField &mv, BlockStats *stats)
 {
+  blk_size = block_size<N>(blk_size);
+
   int  blocks_wide = current.cols/blk_size;
   int  ox = blockx*blk_size;
   int  oy = blocky*blk_size;
   int  mv_block_index = blocky*blocks_wide + blockx;
 
   // We keep a list of which candidate positions to check because when the
-  // search pattern moves we only need to calculate new positions.
+  // search pattern moves we only need to calculate new positions: those to
+  // check first and after moving to each position.
+
+  static const int first[5]      = { 0, 1, 2, 3, 4 };
+  static const int next[5][3]    = { {}, {1,2,4}, {1,2,3}, {2,3,4}, {3,4,1} };
+  static const int next_count[5] = { 0, 3, 3, 3, 3 };
 
-  std::vector<cv::Vec2f> search_mv(5);
-  std::vector<int> candidate_pos(5);
-  std::iota(candidate_pos.begin(), candidate_pos.end(), 0);
+  MotionVector search_mv[5];
+  const int *candidate_pos = first;
+  int candidates = 5;
 
   float best_sad = 1e7;
   int   best_mv_pos = 0;
@@ -273,22 +454,27 @@ void small_diamond_search(const cv::Mat &current, const cv::Mat &previous,
 
   while(process)
   {
-    cv::Vec2f centre_mv = mv[mv_block_index];
+    if(stats) stats->steps++;
+
+    MotionVector centre_mv = mv[mv_block_index];
     search_mv[0] = centre_mv;
-    search_mv[1] = centre_mv; search_mv[1][1]--;  // up
-    search_mv[2] = centre_mv; search_mv[2][0]++;  // right
-    search_mv[3] = centre_mv; search_mv[3][1]++;  // down
-    search_mv[4] = centre_mv; search_mv[4][0]--;  // left
+    search_mv[1] = centre_mv + mv_pixels( 0, -1);   // up
+    search_mv[2] = centre_mv + mv_pixels( 1,  0);   // right
+    search_mv[3] = centre_mv + mv_pixels( 0,  1);   // down
+    search_mv[4] = centre_mv + mv_pixels(-1,  0);   // left
 
     // Get SAD for each candidate
 
-    for(int cand_no : candidate_pos)
+    for(int c = 0; c < candidates; c++)
     {
-      if(is_valid(ox+search_mv[cand_no][0], oy+search_mv[cand_no][1], blk_size, previous))
+      int cand_no = candidate_pos[c];
+      int sx = ox + search_mv[cand_no][0]/MV_UNIT;
+      int sy = oy + search_mv[cand_no][1]/MV_UNIT;
+
+      if(is_valid(sx, sy, blk_size, previous))
       {
-        float bdm = SAD(current, previous, ox, oy,
-                        ox+search_mv[cand_no][0], oy+search_mv[cand_no][1],
-                        blk_size);
+        float bdm = block_sad<N>(current, previous, ox, oy, sx, sy,
+                                 blk_size, best_sad, stats);
 
         if(bdm < best_sad) {
           best_mv_pos = cand_no;
@@ -297,32 +483,11 @@ void small_diamond_search(const cv::Mat &current, const cv::Mat &previous,
       }
     }
 
-    // Update next candidate search positions
+    // Update next candidate search positions; stop at the centre
 
-    candidate_pos.clear();
-
-    switch(best_mv_pos)
-    {
-      case 0:  // centre
-      process = false;
-      break;
-
-      case 1:  // move up
-      candidate_pos.assign({1,2,4});
-      break;
-
-      case 2:  // move right
-      candidate_pos.assign({1,2,3});
-      break;
-
-      case 3:  // move down
-      candidate_pos.assign({2,3,4});
-      break;
-
-      case 4:  // move left
-      candidate_pos.assign({3,4,1});
-      break;
-    }
+    candidate_pos = next[best_mv_pos];
+    candidates    = next_count[best_mv_pos];
+    process       = (best_mv_pos != 0);
 
     if(process) mv[mv_block_index] = search_mv[best_mv_pos];
     best_mv_pos = 0;
@@ -330,7 +495,7 @@ void small_diamond_search(const cv::Mat &current, const cv::Mat &previous,
 }
 
 // Check search location is valid
-bool is_valid(float sx, float sy, int blk_size, const cv::Mat &img)
+bool is_valid(int sx, int sy, int blk_size, const cv::Mat &img)
 {
   if((sx >= 0) && (sy >= 0) &&
      (sx+blk_size < img.cols) &&
@@ -12,6 +12,26 @@
 
 #include <opencv2/core.hpp>
 
+#include "threadpool.h"
+#include "wavefront.h"
+#include "blockstats.h"
+#include "motionvector.h"
+
+/// How PMVFAST blocks finished, to measure the early termination rate
+struct PMVFASTStats
+{
+  long long blocks         = 0;   ///< blocks estimated
+  long long median_stops   = 0;   ///< blocks stopped at the median predictor
+  long long temporal_stops = 0;   ///< blocks stopped at the co-located vector
+};
+
+/// Wavefront progress and statistics of each block row, kept from frame to
+/// frame so that they are only allocated when the image size changes
+struct PMVFASTWorkspace
+{
+  WavefrontProgress         wavefront;
+  std::vector<PMVFASTStats> row_stats;
+};
 
 /**
  * pmvfast
@@ -20,24 +40,85 @@
  *        - Enhancing Block Based Motion Estimation", 2001,
  *        A.M. Tourapis, O.C. Au and M.L. Liou, Proceedings of SPIE,
  *        doi 10.1117/12.411871
- * @param current    current image
- * @param previous   previous image
- * @param blk_size   block size
+ *        Vectors are whole pixels held as quarter pixel MotionVectors.
+ *        Thresholds are scaled by block area from the paper's values for
+ *        16x16 blocks; block sizes 4, 8, 16, 32 and 64 run a version
+ *        compiled for that size.
+ *        When processing a sequence the integer vector field of the
+ *        previous frame can be given; its co-located vector is then checked
+ *        for early termination after the median, and it and the vectors
+ *        right of and below it are added to the predictors.
+ * @param current          current image
+ * @param previous         previous image
+ * @param blk_size         block size
+ * @param previous_field   whole pixel vectors of the previous frame with the
+ *                         same block size, or null for spatial predictors
+ *                         only
+ * @param stats            if not null, how blocks finished is added to this
  * @return  motion vectors
  */
-std::vector<cv::Vec2f> pmvfast(const cv::Mat &current, const cv::Mat &previous,
-                               int blk_size);
+MotionField pmvfast(const cv::Mat &current, const cv::Mat &previous,
+                    int blk_size, const MotionField *previous_field = nullptr,
+                    PMVFASTStats *stats = nullptr);
+
+/**
+ * pmvfast
+ * @brief PMVFAST block matching algorithm run as a wavefront across a
+ *        thread pool; each block row runs two blocks behind the row above
+ *        so that spatial predictors are always available. Gives the same
+ *        vectors as the serial version.
+ * @param current          current image
+ * @param previous         previous image
+ * @param blk_size         block size
+ * @param pool             threads to use
+ * @param previous_field   vectors of the previous frame, or null
+ * @param stats            if not null, how blocks finished is added to this
+ * @return  motion vectors
+ */
+MotionField pmvfast(const cv::Mat &current, const cv::Mat &previous,
+                    int blk_size, ThreadPool &pool,
+                    const MotionField *previous_field = nullptr,
+                    PMVFASTStats *stats = nullptr);
+
+/**
+ * pmvfast
+ * @brief As above using a workspace and writing into an existing field, so
+ *        that nothing is allocated from frame to frame
+ * @param current          current image
+ * @param previous         previous image
+ * @param blk_size         block size
+ * @param pool             threads to run the wavefront on, or null to run
+ *                         serially
+ * @param previous_field   vectors of the previous frame, or null
+ * @param workspace        wavefront progress and statistics
+ * @param mv               motion vectors
+ * @param stats            if not null, how blocks finished is added to this
+ * @param block_stats      if not null, set to the SADs, diamond steps,
+ *                         diamond and exit of each block
+ * @param skip             if not null, static blocks are given a zero vector
+ *                         without a search and are not counted in stats
+ * @param global           if not null, the global motion of the frame in
+ *                         whole pixels, which is added to the predictors
+ *                         of every block
+ */
+void pmvfast(const cv::Mat &current, const cv::Mat &previous, int blk_size,
+             ThreadPool *pool, const MotionField *previous_field,
+             PMVFASTWorkspace &workspace, MotionField &mv,
+             PMVFASTStats *stats = nullptr,
+             BlockStatsField *block_stats = nullptr,
+             const SkipMap *skip = nullptr,
+             const MotionVector *global = nullptr);
 
 // Large diamond search: search pattern is 4-neighbours at distance 2 pixels
 // plus 4 diagonal neighbours at 1 pixel
 void large_diamond_search(const cv::Mat &current, const cv::Mat &previous,
                           int blockx, int blocky, int blk_size,
-                          std::vector<cv::Vec2f> &mv);
+                          MotionField &mv);
 
 // Small diamond search: search pattern is 4-neighbours at distance 1 pixel
 void small_diamond_search(const cv::Mat &current, const cv::Mat &previous,
                           int blockx, int blocky, int blk_size,
-                          std::vector<cv::Vec2f> &mv);
+                          MotionField &mv);
 
 #endif    // pmvfast_h
 
@@ -0,0 +1,165 @@
+/**
+ * @file   sadcheck.cc
+ * @brief  Check the SAD kernels against a plain loop on random blocks
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ *
+ * Checks the kernel set selected at runtime, so run once for each set with
+ * BMA_SAD set as "make check" does. Needs no OpenCV.
+ */
+
+#include <stdlib.h>
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include "sadkernels.h"
+
+/// Random blocks checked for each block size and pair of strides
+#define CHECK_TRIALS 64
+
+/// Extra bytes before and after each block so that blocks can start at any
+/// alignment and candidates kernels can read past the block
+#define CHECK_MARGIN 64
+
+
+// Reference SAD of a block
+static unsigned int plain_sad(const unsigned char *ref, size_t ref_stride,
+                              const unsigned char *search, size_t search_stride,
+                              int size)
+{
+  unsigned int sad = 0;
+
+  for(int y = 0; y < size; y++)
+    for(int x = 0; x < size; x++)
+      sad += std::abs(ref[y*ref_stride + x] - search[y*search_stride + x]);
+
+  return(sad);
+}
+
+// Count and report a failed check
+static void fail(int &failures, const char *what, int size, size_t ref_stride,
+                 size_t search_stride, unsigned int got, unsigned int expected)
+{
+  if(failures++ < 10)
+    std::cout << "  " << what << " size " << size << " strides " << ref_stride
+              << "/" << search_stride << ": got " << got << ", expected "
+              << expected << "\n";
+}
+
+// Check every kernel for one pair of blocks
+static void check_blocks(const unsigned char *ref, size_t ref_stride,
+                         const unsigned char *search, size_t search_stride,
+                         int size, std::mt19937 &rng, int &failures)
+{
+  unsigned int expected = plain_sad(ref, ref_stride, search, search_stride,
+                                    size);
+
+  unsigned int sad = sad_block(ref, ref_stride, search, search_stride, size);
+  if(sad != expected)
+    fail(failures, "sad_block", size, ref_stride, search_stride, sad,
+         expected);
+
+  // Bounds below, at and above the SAD, so blocks stop early or not
+
+  unsigned int bounds[4] = { 0, expected/2, expected,
+                             (unsigned int)(rng() % (expected + 1)) };
+
+  for(unsigned int bound : bounds)
+  {
+    int rows = -1;
+    sad = sad_block_bounded(ref, ref_stride, search, search_stride, size,
+                            bound, rows);
+
+    bool valid = (expected <= bound) ?
+                   ((sad == expected) && (rows == size)) :
+                   ((sad > bound) && (sad <= expected) && (rows >= 1) &&
+                    (rows <= size) && ((rows < size) || (sad == expected)));
+
+    if(!valid)
+      fail(failures, "sad_block_bounded", size, ref_stride, search_stride,
+           sad, expected);
+
+    int kernel_rows = -1;
+    unsigned int kernel_sad = sad_bounded_kernel(size)(ref, ref_stride,
+                                                       search, search_stride,
+                                                       size, bound,
+                                                       kernel_rows);
+    if((kernel_sad != sad) || (kernel_rows != rows))
+      fail(failures, "sad_bounded_kernel", size, ref_stride, search_stride,
+           kernel_sad, sad);
+  }
+
+  sad_candidates_fn candidates = sad_candidates_kernel(size);
+
+  if(candidates)
+  {
+    unsigned int sads[SAD_CANDIDATES];
+    candidates(ref, ref_stride, search, search_stride, sads);
+
+    for(int i = 0; i < SAD_CANDIDATES; i++)
+    {
+      unsigned int candidate = plain_sad(ref, ref_stride, search + i,
+                                         search_stride, size);
+      if(sads[i] != candidate)
+        fail(failures, "sad_candidates_kernel", size, ref_stride,
+             search_stride, sads[i], candidate);
+    }
+  }
+}
+
+// Check a block size at several strides, offsets and kinds of data
+static void check_size(int size, std::mt19937 &rng, int &failures)
+{
+  int width = size + SAD_CANDIDATES_SPAN;
+  size_t strides[4] = { (size_t)width, (size_t)width + 1, (size_t)width + 13,
+                        (size_t)std::max(width, 64) * 3 + 5 };
+
+  for(size_t ref_stride : strides)
+  {
+    for(size_t search_stride : strides)
+    {
+      std::vector<unsigned char> ref(ref_stride*size + 2*CHECK_MARGIN);
+      std::vector<unsigned char> search(search_stride*size + 2*CHECK_MARGIN);
+
+      for(int trial = 0; trial < CHECK_TRIALS; trial++)
+      {
+        // First trials are the extremes, where 16 bit sums would overflow
+
+        for(size_t i = 0; i < ref.size(); i++)
+          ref[i] = (trial == 0) ? 0 : (trial == 1) ? 255 : rng();
+
+        for(size_t i = 0; i < search.size(); i++)
+          search[i] = (trial == 0) ? 255 : (trial == 1) ? 0 :
+                      (trial % 4 == 3) ? (ref[std::min(i, ref.size()-1)] ^
+                                          (rng() & 3)) : rng();
+
+        const unsigned char *r = ref.data() + CHECK_MARGIN/2 + rng() % 32;
+        const unsigned char *s = search.data() + CHECK_MARGIN/2 + rng() % 32;
+
+        check_blocks(r, ref_stride, s, search_stride, size, rng, failures);
+      }
+    }
+  }
+}
+
+int main()
+{
+  // Kernel sizes, and sizes left to the scalar loop
+
+  const int sizes[] = { 4, 8, 16, 32, 64, 2, 12, 24 };
+
+  std::mt19937 rng(20261016);
+  int failures = 0;
+
+  for(int size : sizes)
+    check_size(size, rng, failures);
+
+  std::cout << "SAD kernels " << sad_kernel_name() << ": "
+            << (failures ? "FAILED" : "passed");
+  if(failures) std::cout << " " << failures << " checks";
+  std::cout << "\n";
+
+  return(failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,518 @@
+/**
+ * @file   sadkernels.cc
+ * @brief  Integer SAD kernels with runtime CPU dispatch
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <climits>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define BMA_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+#include "sadkernels.h"
+
+
+// Kernels stop when the running sum is greater than the bound, returning
+// the number of rows summed. The fixed width kernels are only used for
+// square blocks of their own width, so that loops have constant trip
+// counts. The SIMD kernels are so cheap per row that a check costs more
+// than it saves unless it is made every SAD_CHECK_PIXELS or so.
+
+// Kernel set; for block widths 4, 8, 16, 32 and 64, without and with
+// early termination, and SADs of SAD_CANDIDATES neighbouring candidates if
+// the set has kernels for them
+struct SADKernels
+{
+  const char *name;
+  sad_fn sad[5];
+  sad_fn bounded[5];
+  sad_candidates_fn candidates[5];
+};
+
+// Rows between checks for SIMD kernel of width wide
+static constexpr int check_rows(int wide)
+{
+  return(std::max(SAD_ROW_GROUP, SAD_CHECK_PIXELS/wide));
+}
+
+// Scalar kernel, used for any block size; checks every SAD_ROW_GROUP rows
+template<bool BOUNDED>
+static unsigned int sad_scalar(const unsigned char *ref, size_t ref_stride,
+                               const unsigned char *search, size_t search_stride,
+                               int size, unsigned int bound, int &rows)
+{
+  unsigned int sad = 0;
+  int y = 0;
+
+  while((y < size) && (!BOUNDED || (sad <= bound)))
+  {
+    int end = std::min(y + SAD_ROW_GROUP, size);
+
+    for(; y < end; y++)
+    {
+      for(int x = 0; x < size; x++)
+        sad += std::abs(ref[x] - search[x]);
+
+      ref    += ref_stride;
+      search += search_stride;
+    }
+  }
+
+  rows = y;
+  return(sad);
+}
+
+// Scalar kernel for blocks of width W; as above with constant trip counts
+// so that the compiler can unroll and vectorise it
+template<int W, bool BOUNDED>
+static unsigned int sad_scalar_w(const unsigned char *ref, size_t ref_stride,
+                                 const unsigned char *search, size_t search_stride,
+                                 int size, unsigned int bound, int &rows)
+{
+  unsigned int sad = 0;
+  int y = 0;
+
+  while((y < W) && (!BOUNDED || (sad <= bound)))
+  {
+    int end = std::min(y + SAD_ROW_GROUP, W);
+
+    for(; y < end; y++)
+    {
+      for(int x = 0; x < W; x++)
+        sad += std::abs(ref[x] - search[x]);
+
+      ref    += ref_stride;
+      search += search_stride;
+    }
+  }
+
+  rows = y;
+  return(sad);
+}
+
+#ifdef BMA_X86_SIMD
+
+// Add the two 64 bit halves of a _mm_sad_epu8 accumulator
+static inline unsigned int hsum_sad(__m128i acc)
+{
+  return(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+}
+
+// Load 4 bytes without alignment or aliasing assumptions
+static inline __m128i load4(const unsigned char *p)
+{
+  int v;
+  std::memcpy(&v, p, sizeof(v));
+  return(_mm_cvtsi32_si128(v));
+}
+
+// SSE2, 4 pixels wide: pack 4 rows into one register
+template<bool BOUNDED>
+static unsigned int sad_sse2_w4(const unsigned char *ref, size_t ref_stride,
+                                const unsigned char *search, size_t search_stride,
+                                int size, unsigned int bound, int &rows)
+{
+  constexpr int W = 4;
+  __m128i acc = _mm_setzero_si128();
+
+  int y = 0;
+
+  while(y < W)
+  {
+    int end = std::min(y + check_rows(W), W);
+
+    for(; y < end; y += 4)
+    {
+      __m128i r = _mm_unpacklo_epi64(
+                    _mm_unpacklo_epi32(load4(ref), load4(ref+ref_stride)),
+                    _mm_unpacklo_epi32(load4(ref+2*ref_stride),
+                                       load4(ref+3*ref_stride)));
+      __m128i s = _mm_unpacklo_epi64(
+                    _mm_unpacklo_epi32(load4(search), load4(search+search_stride)),
+                    _mm_unpacklo_epi32(load4(search+2*search_stride),
+                                       load4(search+3*search_stride)));
+      acc = _mm_add_epi64(acc, _mm_sad_epu8(r, s));
+
+      ref    += 4*ref_stride;
+      search += 4*search_stride;
+    }
+
+    if(BOUNDED && (y < W) && (hsum_sad(acc) > bound)) break;
+  }
+
+  rows = y;
+  return(hsum_sad(acc));
+}
+
+// SSE2, 8 pixels wide: pack 2 rows into one register
+template<bool BOUNDED>
+static unsigned int sad_sse2_w8(const unsigned char *ref, size_t ref_stride,
+                                const unsigned char *search, size_t search_stride,
+                                int size, unsigned int bound, int &rows)
+{
+  constexpr int W = 8;
+  __m128i acc = _mm_setzero_si128();
+
+  int y = 0;
+
+  while(y < W)
+  {
+    int end = std::min(y + check_rows(W), W);
+
+    for(; y < end; y += 2)
+    {
+      __m128i r = _mm_unpacklo_epi64(
+                    _mm_loadl_epi64((const __m128i *)ref),
+                    _mm_loadl_epi64((const __m128i *)(ref+ref_stride)));
+      __m128i s = _mm_unpacklo_epi64(
+                    _mm_loadl_epi64((const __m128i *)search),
+                    _mm_loadl_epi64((const __m128i *)(search+search_stride)));
+      acc = _mm_add_epi64(acc, _mm_sad_epu8(r, s));
+
+      ref    += 2*ref_stride;
+      search += 2*search_stride;
+    }
+
+    if(BOUNDED && (y < W) && (hsum_sad(acc) > bound)) break;
+  }
+
+  rows = y;
+  return(hsum_sad(acc));
+}
+
+// SSE2, multiple of 16 pixels wide
+template<int W, bool BOUNDED>
+static unsigned int sad_sse2_w16n(const unsigned char *ref, size_t ref_stride,
+                                  const unsigned char *search, size_t search_stride,
+                                  int size, unsigned int bound, int &rows)
+{
+  __m128i acc = _mm_setzero_si128();
+
+  int y = 0;
+
+  while(y < W)
+  {
+    int end = std::min(y + check_rows(W), W);
+
+    for(; y < end; y++)
+    {
+      for(int x = 0; x < W; x += 16)
+      {
+        __m128i r = _mm_loadu_si128((const __m128i *)(ref+x));
+        __m128i s = _mm_loadu_si128((const __m128i *)(search+x));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(r, s));
+      }
+
+      ref    += ref_stride;
+      search += search_stride;
+    }
+
+    if(BOUNDED && (y < W) && (hsum_sad(acc) > bound)) break;
+  }
+
+  rows = y;
+  return(hsum_sad(acc));
+}
+
+// Add the four 64 bit lanes of a _mm256_sad_epu8 accumulator
+__attribute__((target("avx2")))
+static inline unsigned int hsum_sad256(__m256i acc)
+{
+  __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(acc),
+                              _mm256_extracti128_si256(acc, 1));
+  return(hsum_sad(sum));
+}
+
+// AVX2, 16 pixels wide: pack 2 rows into one register
+template<bool BOUNDED>
+__attribute__((target("avx2")))
+static unsigned int sad_avx2_w16(const unsigned char *ref, size_t ref_stride,
+                                 const unsigned char *search, size_t search_stride,
+                                 int size, unsigned int bound, int &rows)
+{
+  constexpr int W = 16;
+  __m256i acc = _mm256_setzero_si256();
+
+  int y = 0;
+
+  while(y < W)
+  {
+    int end = std::min(y + check_rows(W), W);
+
+    for(; y < end; y += 2)
+    {
+      __m256i r = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)ref)),
+                    _mm_loadu_si128((const __m128i *)(ref+ref_stride)), 1);
+      __m256i s = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)search)),
+                    _mm_loadu_si128((const __m128i *)(search+search_stride)), 1);
+      acc = _mm256_add_epi64(acc, _mm256_sad_epu8(r, s));
+
+      ref    += 2*ref_stride;
+      search += 2*search_stride;
+    }
+
+    if(BOUNDED && (y < W) && (hsum_sad256(acc) > bound)) break;
+  }
+
+  rows = y;
+  return(hsum_sad256(acc));
+}
+
+// AVX2, multiple of 32 pixels wide
+template<int W, bool BOUNDED>
+__attribute__((target("avx2")))
+static unsigned int sad_avx2_w32n(const unsigned char *ref, size_t ref_stride,
+                                  const unsigned char *search, size_t search_stride,
+                                  int size, unsigned int bound, int &rows)
+{
+  __m256i acc = _mm256_setzero_si256();
+
+  int y = 0;
+
+  while(y < W)
+  {
+    int end = std::min(y + check_rows(W), W);
+
+    for(; y < end; y++)
+    {
+      for(int x = 0; x < W; x += 32)
+      {
+        __m256i r = _mm256_loadu_si256((const __m256i *)(ref+x));
+        __m256i s = _mm256_loadu_si256((const __m256i *)(search+x));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(r, s));
+      }
+
+      ref    += ref_stride;
+      search += search_stride;
+    }
+
+    if(BOUNDED && (y < W) && (hsum_sad256(acc) > bound)) break;
+  }
+
+  rows = y;
+  return(hsum_sad256(acc));
+}
+
+// Load 16 bytes of two rows into the two lanes of a register
+__attribute__((target("avx2")))
+static inline __m256i load_rows(const unsigned char *p, size_t stride)
+{
+  return(_mm256_inserti128_si256(
+           _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p)),
+           _mm_loadu_si128((const __m128i *)(p+stride)), 1));
+}
+
+// Load the first W pixels, up to 16, of two block rows into the two lanes
+// of a register, without reading past the block
+template<int W>
+__attribute__((target("avx2")))
+static inline __m256i load_block_rows(const unsigned char *p, size_t stride)
+{
+  if(W == 4)
+    return(_mm256_inserti128_si256(_mm256_castsi128_si256(load4(p)),
+                                   load4(p+stride), 1));
+  if(W == 8)
+    return(_mm256_inserti128_si256(
+             _mm256_castsi128_si256(_mm_loadl_epi64((const __m128i *)p)),
+             _mm_loadl_epi64((const __m128i *)(p+stride)), 1));
+
+  return(load_rows(p, stride));
+}
+
+// Add the SADs of 4 pixels of group Q of two block rows in r at the 8
+// offsets of the search rows from p
+template<int Q>
+__attribute__((target("avx2")))
+static inline __m256i mpsad_group(__m256i acc, __m256i r,
+                                  const unsigned char *p, size_t stride)
+{
+  __m256i s = load_rows(p + 4*Q, stride);
+  return(_mm256_add_epi16(acc, _mm256_mpsadbw_epu8(s, r, Q | (Q << 3))));
+}
+
+// AVX2, SADs of a block of width W at 8 neighbouring candidates. Each
+// vmpsadbw gives the SADs of a 4 pixel group of a row at 8 offsets, in
+// each lane, so two rows are done at once. Sums are kept in 16 bits for
+// as many row pairs as cannot overflow and then added to 32 bit sums.
+template<int W>
+__attribute__((target("avx2")))
+static void sad_avx2_candidates(const unsigned char *ref, size_t ref_stride,
+                                const unsigned char *search,
+                                size_t search_stride, unsigned int *sads)
+{
+  constexpr int PAIRS = std::min(W/2, 257/W);
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i lo = zero, hi = zero;
+
+  for(int y = 0; y < W; y += 2*PAIRS)
+  {
+    __m256i acc = zero;
+
+    for(int pair = 0; pair < PAIRS; pair++)
+    {
+      for(int x = 0; x < W; x += 16)
+      {
+        __m256i r = load_block_rows<W>(ref + x, ref_stride);
+
+        acc = mpsad_group<0>(acc, r, search + x, search_stride);
+        if(W >= 8)
+          acc = mpsad_group<1>(acc, r, search + x, search_stride);
+        if(W >= 16)
+        {
+          acc = mpsad_group<2>(acc, r, search + x, search_stride);
+          acc = mpsad_group<3>(acc, r, search + x, search_stride);
+        }
+      }
+
+      ref    += 2*ref_stride;
+      search += 2*search_stride;
+    }
+
+    lo = _mm256_add_epi32(lo, _mm256_unpacklo_epi16(acc, zero));
+    hi = _mm256_add_epi32(hi, _mm256_unpackhi_epi16(acc, zero));
+  }
+
+  // Add the even and odd rows of each candidate
+
+  _mm_storeu_si128((__m128i *)sads,
+                   _mm_add_epi32(_mm256_castsi256_si128(lo),
+                                 _mm256_extracti128_si256(lo, 1)));
+  _mm_storeu_si128((__m128i *)(sads+4),
+                   _mm_add_epi32(_mm256_castsi256_si128(hi),
+                                 _mm256_extracti128_si256(hi, 1)));
+}
+
+#endif    // BMA_X86_SIMD
+
+static const SADKernels scalar_kernels =
+  { "scalar",
+    { sad_scalar_w<4, false>, sad_scalar_w<8, false>, sad_scalar_w<16, false>,
+      sad_scalar_w<32, false>, sad_scalar_w<64, false> },
+    { sad_scalar_w<4, true>, sad_scalar_w<8, true>, sad_scalar_w<16, true>,
+      sad_scalar_w<32, true>, sad_scalar_w<64, true> },
+    { nullptr, nullptr, nullptr, nullptr, nullptr } };
+
+#ifdef BMA_X86_SIMD
+static const SADKernels sse2_kernels =
+  { "sse2",
+    { sad_sse2_w4<false>, sad_sse2_w8<false>, sad_sse2_w16n<16, false>,
+      sad_sse2_w16n<32, false>, sad_sse2_w16n<64, false> },
+    { sad_sse2_w4<true>, sad_sse2_w8<true>, sad_sse2_w16n<16, true>,
+      sad_sse2_w16n<32, true>, sad_sse2_w16n<64, true> },
+    { nullptr, nullptr, nullptr, nullptr, nullptr } };
+
+static const SADKernels avx2_kernels =
+  { "avx2",
+    { sad_sse2_w4<false>, sad_sse2_w8<false>, sad_avx2_w16<false>,
+      sad_avx2_w32n<32, false>, sad_avx2_w32n<64, false> },
+    { sad_sse2_w4<true>, sad_sse2_w8<true>, sad_avx2_w16<true>,
+      sad_avx2_w32n<32, true>, sad_avx2_w32n<64, true> },
+    { sad_avx2_candidates<4>, sad_avx2_candidates<8>,
+      sad_avx2_candidates<16>, sad_avx2_candidates<32>,
+      sad_avx2_candidates<64> } };
+#endif
+
+// Choose the best kernel set for this CPU, unless overridden by BMA_SAD
+static const SADKernels *select_kernels()
+{
+  const char *request = std::getenv("BMA_SAD");
+
+  if(request && !std::strcmp(request, "scalar")) return(&scalar_kernels);
+
+#ifdef BMA_X86_SIMD
+  if(request && !std::strcmp(request, "sse2")) return(&sse2_kernels);
+
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2")) return(&avx2_kernels);
+
+  return(&sse2_kernels);
+#else
+  return(&scalar_kernels);
+#endif
+}
+
+static const SADKernels *kernels()
+{
+  static const SADKernels *selected = select_kernels();
+  return(selected);
+}
+
+// Index of kernel for block size, or -1 for scalar
+static inline int kernel_index(int size)
+{
+  switch(size)
+  {
+    case 4:  return(0);
+    case 8:  return(1);
+    case 16: return(2);
+    case 32: return(3);
+    case 64: return(4);
+  }
+
+  return(-1);
+}
+
+// Integer SAD
+unsigned int sad_block(const unsigned char *ref, size_t ref_stride,
+                       const unsigned char *search, size_t search_stride,
+                       int size)
+{
+  int rows;
+  int k = kernel_index(size);
+
+  if(k < 0)
+    return(sad_scalar<false>(ref, ref_stride, search, search_stride,
+                             size, UINT_MAX, rows));
+
+  return(kernels()->sad[k](ref, ref_stride, search, search_stride,
+                           size, UINT_MAX, rows));
+}
+
+// Integer SAD with early termination
+unsigned int sad_block_bounded(const unsigned char *ref, size_t ref_stride,
+                               const unsigned char *search, size_t search_stride,
+                               int size, unsigned int bound, int &rows)
+{
+  int k = kernel_index(size);
+
+  if(k < 0)
+    return(sad_scalar<true>(ref, ref_stride, search, search_stride,
+                            size, bound, rows));
+
+  return(kernels()->bounded[k](ref, ref_stride, search, search_stride,
+                               size, bound, rows));
+}
+
+// Bounded kernel for block size
+sad_fn sad_bounded_kernel(int size)
+{
+  int k = kernel_index(size);
+
+  if(k < 0) return(sad_scalar<true>);
+
+  return(kernels()->bounded[k]);
+}
+
+// Candidates kernel for block size
+sad_candidates_fn sad_candidates_kernel(int size)
+{
+  int k = kernel_index(size);
+
+  if(k < 0) return(nullptr);
+
+  return(kernels()->candidates[k]);
+}
+
+// Kernel set name
+const char *sad_kernel_name()
+{
+  return(kernels()->name);
+}
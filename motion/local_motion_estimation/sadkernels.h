@@ -0,0 +1,107 @@
+/**
+ * @file   sadkernels.h
+ * @brief  Integer SAD kernels with runtime CPU dispatch
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#ifndef sadkernels_h
+#define sadkernels_h
+
+#include <cstddef>
+
+/// Number of rows between checks of the running SAD against a bound
+#define SAD_ROW_GROUP 4
+
+/// Least number of pixels between checks by the SIMD kernels, so blocks up
+/// to 16x16 are always summed in full and 32x32 blocks are checked every
+/// 8 rows
+#define SAD_CHECK_PIXELS 256
+
+/// Number of horizontally neighbouring candidates whose SADs a candidates
+/// kernel calculates in one call
+#define SAD_CANDIDATES 8
+
+/// Pixels of each search row that a candidates kernel reads beyond the
+/// block size; more than the SAD_CANDIDATES-1 that the candidates need
+#define SAD_CANDIDATES_SPAN 12
+
+/// Bounded SAD kernel; arguments as sad_block_bounded()
+typedef unsigned int (*sad_fn)(const unsigned char *ref, size_t ref_stride,
+                               const unsigned char *search, size_t search_stride,
+                               int size, unsigned int bound, int &rows);
+
+/**
+ * Candidates SAD kernel: SADs of a block against the SAD_CANDIDATES search
+ * blocks starting at search, search+1, ... in sads. Reads size +
+ * SAD_CANDIDATES_SPAN pixels of each of size search rows.
+ */
+typedef void (*sad_candidates_fn)(const unsigned char *ref, size_t ref_stride,
+                                  const unsigned char *search,
+                                  size_t search_stride, unsigned int *sads);
+
+/**
+ * Integer SAD of two 8 bit blocks at integer pixel positions.
+ * Uses SSE2/AVX2 kernels for block widths 4, 8, 16, 32 and 64 when the CPU
+ * supports them, otherwise a scalar loop. All kernels give identical results.
+ * @param ref             top left pixel of reference block
+ * @param ref_stride      row stride of reference image in bytes
+ * @param search          top left pixel of search block
+ * @param search_stride   row stride of search image in bytes
+ * @param size            block size
+ * @return SAD for block
+ */
+unsigned int sad_block(const unsigned char *ref, size_t ref_stride,
+                       const unsigned char *search, size_t search_stride,
+                       int size);
+
+/**
+ * Integer SAD of two 8 bit blocks with early termination. The running sum
+ * is checked against the bound every SAD_ROW_GROUP rows, or at least every
+ * SAD_CHECK_PIXELS pixels for the SIMD kernels, and the remaining rows are
+ * skipped once it is greater.
+ * @param ref             top left pixel of reference block
+ * @param ref_stride      row stride of reference image in bytes
+ * @param search          top left pixel of search block
+ * @param search_stride   row stride of search image in bytes
+ * @param size            block size
+ * @param bound           stop when the running sum is greater than this
+ * @param rows            number of rows that were summed
+ * @return SAD for block if not greater than bound, else a partial sum that
+ *         is greater than bound
+ */
+unsigned int sad_block_bounded(const unsigned char *ref, size_t ref_stride,
+                               const unsigned char *search, size_t search_stride,
+                               int size, unsigned int bound, int &rows);
+
+/**
+ * Bounded kernel that sad_block_bounded() uses for a block size, so that
+ * callers with a fixed block size can look it up once rather than on every
+ * call. Each of the block sizes 4, 8, 16, 32 and 64 has its own kernel with
+ * constant trip counts, including the scalar set.
+ * @param size            block size
+ * @return kernel
+ */
+sad_fn sad_bounded_kernel(int size);
+
+/**
+ * Kernel calculating the SADs of a row of neighbouring candidates for a
+ * block size, so that the whole cost surface of a full search can be built
+ * a row at a time. Only the AVX2 set has them, using vmpsadbw, which sums
+ * each 4 pixel group of a row at 8 offsets in one instruction; the results
+ * are identical to sad_block().
+ * @param size            block size
+ * @return kernel, or null if the block size or kernel set has none
+ */
+sad_candidates_fn sad_candidates_kernel(int size);
+
+/**
+ * Name of the kernel set selected at runtime; "avx2", "sse2" or "scalar".
+ * The selection can be overridden by setting the BMA_SAD environment
+ * variable to one of these names, e.g. to check results against scalar.
+ * @return kernel set name
+ */
+const char *sad_kernel_name();
+
+#endif    // sadkernels_h
+
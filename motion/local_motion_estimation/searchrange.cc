@@ -0,0 +1,71 @@
+/**
+ * @file   searchrange.cc
+ * @brief  Size search windows from the motion of the previous frame
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "searchrange.h"
+
+
+// Length of a vector in whole pixels, rounding up
+static int vector_length(const MotionVector &v)
+{
+  int length = std::max(std::abs((int)v[0]), std::abs((int)v[1]));
+  return((length + MV_UNIT-1) >> MV_FRAC_BITS);
+}
+
+// Search ranges of the next frame from the vectors of this one
+void adaptive_ranges(const MotionField &mv, int blocks_wide, int range,
+                     int margin, int region, const RangeMap *used,
+                     RangeWorkspace &workspace, RangeMap &ranges,
+                     MotionVector centre)
+{
+  int blocks_high = blocks_wide ? (int)mv.size()/blocks_wide : 0;
+
+  if(region <= 0) region = std::max(blocks_wide, blocks_high);
+
+  ranges.resize(mv.size());
+
+  std::vector<int> &lengths = workspace.lengths;
+
+  // Regions are disjoint, so each reads the ranges it was searched with
+  // before writing its new ones
+
+  for(int ry = 0; ry < blocks_high; ry += region)
+  {
+    for(int rx = 0; rx < blocks_wide; rx += region)
+    {
+      int xend = std::min(rx + region, blocks_wide);
+      int yend = std::min(ry + region, blocks_high);
+
+      lengths.clear();
+
+      for(int by = ry; by < yend; by++)
+      {
+        for(int bx = rx; bx < xend; bx++)
+        {
+          int index = by*blocks_wide + bx;
+          int length = std::min(vector_length(mv[index]),
+                                vector_length(mv[index] - centre));
+
+          if(length >= block_range(used, index, range)) length = range;
+          lengths.push_back(length);
+        }
+      }
+
+      size_t k = (lengths.size()-1)*RANGE_PERCENTILE/100;
+      std::nth_element(lengths.begin(), lengths.begin() + k, lengths.end());
+
+      int next = (lengths[k] >= range) ? range :
+                 std::min(lengths[k] + margin, range);
+
+      for(int by = ry; by < yend; by++)
+        std::fill(ranges.begin() + by*blocks_wide + rx,
+                  ranges.begin() + by*blocks_wide + xend, next);
+    }
+  }
+}
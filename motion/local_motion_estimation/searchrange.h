@@ -0,0 +1,70 @@
+/**
+ * @file   searchrange.h
+ * @brief  Size search windows from the motion of the previous frame
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#ifndef searchrange_h
+#define searchrange_h
+
+#include <vector>
+
+#include "motionvector.h"
+
+/// Percentile of vector lengths that an adaptive search range covers
+#define RANGE_PERCENTILE 99
+
+/// Default pixels an adaptive search range adds to the percentile
+#define RANGE_MARGIN 2
+
+
+/// Buffers for adaptive_ranges(), kept from frame to frame
+struct RangeWorkspace
+{
+  std::vector<int> lengths;    ///< vector lengths of a region
+};
+
+
+/**
+ * adaptive_ranges
+ * @brief Size the search range of each block of the next frame from the
+ *        integer vectors of this one. The length of a vector is the larger
+ *        component of its distance from the nearer of the zero vector and
+ *        centre in whole pixels; the range of a region is the
+ *        RANGE_PERCENTILE percentile of the lengths of its blocks plus
+ *        margin, at most range. A vector at the edge of the window it was
+ *        searched in may have been cut short, so it counts as range long:
+ *        once more than 1% of a region's vectors reach the edge the region
+ *        goes back to the full range rather than growing by margin a frame.
+ * @param mv          integer motion vectors of this frame
+ * @param blocks_wide blocks per row of mv
+ * @param range       largest search range
+ * @param margin      pixels added to the percentile; at least 1
+ * @param region      region size in blocks; 0 for one range for the frame
+ * @param used        range of each block of mv, or null if every block was
+ *                    searched with range
+ * @param workspace   buffers
+ * @param ranges      set to the range of each block, resized as necessary;
+ *                    may be the same map as used
+ * @param centre      centre of the second window mv was searched in,
+ *                    e.g. the global motion
+ */
+void adaptive_ranges(const MotionField &mv, int blocks_wide, int range,
+                     int margin, int region, const RangeMap *used,
+                     RangeWorkspace &workspace, RangeMap &ranges,
+                     MotionVector centre = MotionVector(0, 0));
+
+/**
+ * Search range of a block
+ * @param ranges     range of each block, or null if there are none
+ * @param index      block index in raster order
+ * @param range      range of every block if there are no ranges
+ * @return range in pixels
+ */
+inline int block_range(const RangeMap *ranges, int index, int range)
+{
+  return(ranges ? (*ranges)[index] : range);
+}
+
+#endif    // searchrange_h
@@ -0,0 +1,63 @@
+/**
+ * @file   staticblocks.cc
+ * @brief  Find blocks that have not changed since the previous frame
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#include <algorithm>
+
+#include "staticblocks.h"
+#include "bmsupport.h"
+
+
+// Mark static blocks
+int static_blocks(const cv::Mat &current, const cv::Mat &previous,
+                  int blk_size, float threshold, ThreadPool *pool,
+                  SkipMap &skip)
+{
+  int blocks_wide = current.cols/blk_size;
+  int blocks_high = current.rows/blk_size;
+
+  skip.resize(blocks_wide*blocks_high);
+
+  // The SAD stops once it passes the bound, so moving blocks cost little
+
+  int bound = (int)(threshold*blk_size*blk_size);
+
+  auto process_row = [&](int by)
+  {
+    for(int bx = 0; bx < blocks_wide; bx++)
+    {
+      int ox = bx*blk_size;
+      int oy = by*blk_size;
+
+      skip[by*blocks_wide + bx] =
+        (SAD_integer_bounded(current, previous, ox, oy, ox, oy, blk_size,
+                             bound) <= bound);
+    }
+  };
+
+  if(pool)
+    pool->parallel_for(blocks_high, process_row);
+  else
+  {
+    for(int by = 0; by < blocks_high; by++) process_row(by);
+  }
+
+  return((int)std::count(skip.begin(), skip.end(), 1));
+}
+
+// Skip map at a smaller block size
+void subdivide_skip_map(const SkipMap &skip, int blocks_wide, int factor,
+                        SkipMap &smaller)
+{
+  int blocks_high = blocks_wide ? (int)skip.size()/blocks_wide : 0;
+  int wide = blocks_wide*factor;
+
+  smaller.resize(skip.size()*factor*factor);
+
+  for(int y = 0; y < blocks_high*factor; y++)
+    for(int x = 0; x < wide; x++)
+      smaller[y*wide + x] = skip[(y/factor)*blocks_wide + x/factor];
+}
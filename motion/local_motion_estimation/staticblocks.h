@@ -0,0 +1,59 @@
+/**
+ * @file   staticblocks.h
+ * @brief  Find blocks that have not changed since the previous frame
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#ifndef staticblocks_h
+#define staticblocks_h
+
+#include <opencv2/core.hpp>
+
+#include "threadpool.h"
+#include "motionvector.h"
+
+
+/**
+ * static_blocks
+ * @brief Mark the blocks whose SAD with the same block of the previous
+ *        image, i.e. at the zero vector, is at most threshold per pixel.
+ *        This costs one bounded SAD per block, so searches can give static
+ *        blocks a zero vector rather than searching them, which saves most
+ *        of the time on fixed camera footage.
+ * @param current    current image
+ * @param previous   previous image
+ * @param blk_size   block size
+ * @param threshold  greatest mean absolute difference of a static block
+ * @param pool       threads to use, or null to run serially
+ * @param skip       set to the flag of each block, resized as necessary
+ * @return number of static blocks
+ */
+int static_blocks(const cv::Mat &current, const cv::Mat &previous,
+                  int blk_size, float threshold, ThreadPool *pool,
+                  SkipMap &skip);
+
+/**
+ * Skip map of the same image at a block size factor times smaller; every
+ * sub-block of a static block is static
+ * @param skip       static block flags
+ * @param blocks_wide blocks per row of skip
+ * @param factor     ratio of the block sizes
+ * @param smaller    set to the flags of the smaller blocks, resized as
+ *                   necessary
+ */
+void subdivide_skip_map(const SkipMap &skip, int blocks_wide, int factor,
+                        SkipMap &smaller);
+
+/**
+ * Whether a block is static
+ * @param skip       static block flags, or null if there are none
+ * @param index      block index in raster order
+ * @return true if the block is static
+ */
+inline bool is_static(const SkipMap *skip, int index)
+{
+  return(skip && (*skip)[index]);
+}
+
+#endif    // staticblocks_h
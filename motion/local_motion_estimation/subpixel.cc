@@ -5,64 +5,200 @@
  * @date   2025.10.01
  */
 
+#include <cmath>
+#include <algorithm>
+
 #include "subpixel.h"
+#include "staticblocks.h"
 
 
 // Subpixel motion estimation
 void subpixel_search(const cv::Mat &current, const cv::Mat &previous,
-                     int blk_size, std::vector<cv::Vec2f> &motion)
+                     int blk_size, MotionField &motion)
+{
+  InterpolatedReference reference(previous);
+  subpixel_search(current, reference, blk_size, motion);
+}
+
+// Name of subpixel mode
+const char *subpixel_mode_name(SubpixelMode mode)
+{
+  switch(mode) {
+    case SUBPIXEL_TWO_STAGE: return("twostage");
+    case SUBPIXEL_PARABOLIC: return("parabolic");
+    default:                 return("full");
+  }
+}
+
+// Find subpixel mode by name
+bool find_subpixel_mode(const std::string &name, SubpixelMode &mode)
+{
+  for(SubpixelMode m : { SUBPIXEL_FULL, SUBPIXEL_TWO_STAGE, SUBPIXEL_PARABOLIC })
+  {
+    if(name == subpixel_mode_name(m))
+    {
+      mode = m;
+      return(true);
+    }
+  }
+
+  return(false);
+}
+
+// Offset of the minimum of a parabola through SADs at -1, 0 and +1 pixel in
+// quarter pixels, from -2 to 2; 0 if the SADs are not convex
+static int parabola_offset(float minus, float centre, float plus)
+{
+  float curvature = minus - 2*centre + plus;
+  if(curvature <= 0) return(0);
+
+  int offset = (int)(std::lround(2*(minus - plus)/curvature));
+  return(std::clamp(offset, -MV_UNIT/2, MV_UNIT/2));
+}
+
+// Subpixel motion estimation with interpolated previous frame
+void subpixel_search(const cv::Mat &current,
+                     const InterpolatedReference &previous,
+                     int blk_size, MotionField &motion,
+                     BlockStatsField *block_stats, const SkipMap *skip,
+                     SubpixelMode mode)
 {
   int blocks_wide = current.cols/blk_size;
   int blocks_high = current.rows/blk_size;
 
+  if(block_stats) block_stats->resize(motion.size());
+
   for(int by = 0; by < blocks_high; by++)
   {
     for(int bx = 0; bx < blocks_wide; bx++)
     {
+      if(is_static(skip, by*blocks_wide + bx)) continue;
+
       int ox = bx*blk_size;
       int oy = by*blk_size;
 
-      cv::Vec2f integer_vec = motion[by*blocks_wide + bx];
-      cv::Vec2f best_vec = integer_vec;
+      MotionVector integer_vec = motion[by*blocks_wide + bx];
+      MotionVector best_vec = integer_vec;
 
       int x, y;
       float error;
       float best = 1e7;
+      int candidates = 0;
+
+      // Block origin of integer vector in quarter pixels
+
+      int qx = ox*MV_UNIT + integer_vec[0];
+      int qy = oy*MV_UNIT + integer_vec[1];
 
       // Set up limits
 
       int minx, miny, maxx, maxy;
       minx = -3; maxx = 3; miny = -3; maxy = 3;
 
-      if(ox+integer_vec[0]+blk_size >= previous.cols)
+      if(qx+blk_size*MV_UNIT >= previous.cols()*MV_UNIT)
         maxx = 0;
-      if(oy+integer_vec[1]+blk_size >= previous.rows)
+      if(qy+blk_size*MV_UNIT >= previous.rows()*MV_UNIT)
         maxy = 0;
 
-      if(ox+integer_vec[0] <= 0)
+      if(qx <= 0)
         minx = 0;
-      if(oy+integer_vec[1] <= 0)
+      if(qy <= 0)
         miny = 0;
 
-      // Find best subpixel match
+      // Check an offset within the limits
+
+      auto check = [&](int dx, int dy)
+      {
+        if((dx < minx) || (dx > maxx) || (dy < miny) || (dy > maxy)) return;
+
+        candidates++;
+        error = SAD_qpel_bounded(current, previous, ox, oy, qx+dx, qy+dy,
+                                 blk_size, best);
 
-      for(y = miny; y <= maxy; y++)
+        if(error < best)
+        {
+          best = error;
+          best_vec = integer_vec + MotionVector(dx, dy);
+        }
+      };
+
+      if(mode == SUBPIXEL_TWO_STAGE)
       {
-        for(x = minx; x <= maxx; x++)
+        // Half pixel neighbours, then quarter pixel neighbours of the best
+
+        check(0, 0);
+
+        for(y = -1; y <= 1; y++)
+          for(x = -1; x <= 1; x++)
+            if(x || y) check(2*x, 2*y);
+
+        int cx = best_vec[0] - integer_vec[0];
+        int cy = best_vec[1] - integer_vec[1];
+
+        for(y = -1; y <= 1; y++)
+          for(x = -1; x <= 1; x++)
+            if(x || y) check(cx + x, cy + y);
+      }
+      else if(mode == SUBPIXEL_PARABOLIC)
+      {
+        // Whole pixel SADs need no interpolation; an axis is only fitted
+        // where both neighbours are within the limits
+
+        float centre = SAD_qpel_bounded(current, previous, ox, oy, qx, qy,
+                                        blk_size, best);
+        candidates = 1;
+
+        int fx = 0, fy = 0;
+
+        if((minx < 0) && (maxx > 0))
+        {
+          fx = parabola_offset(
+                 SAD_qpel_bounded(current, previous, ox, oy, qx-MV_UNIT, qy,
+                                  blk_size, best),
+                 centre,
+                 SAD_qpel_bounded(current, previous, ox, oy, qx+MV_UNIT, qy,
+                                  blk_size, best));
+          candidates += 2;
+        }
+
+        if((miny < 0) && (maxy > 0))
         {
-          float dx = integer_vec[0]+(x*0.25);
-          float dy = integer_vec[1]+(y*0.25);
-          error = SAD(current, previous, ox, oy, ox+dx, oy+dy, blk_size);
+          fy = parabola_offset(
+                 SAD_qpel_bounded(current, previous, ox, oy, qx, qy-MV_UNIT,
+                                  blk_size, best),
+                 centre,
+                 SAD_qpel_bounded(current, previous, ox, oy, qx, qy+MV_UNIT,
+                                  blk_size, best));
+          candidates += 2;
+        }
+
+        best_vec = integer_vec + MotionVector(fx, fy);
+      }
+      else
+      {
+        // Find best subpixel match
 
-          if(error < best)
+        for(y = miny; y <= maxy; y++)
+        {
+          for(x = minx; x <= maxx; x++)
           {
-            best = error;
-            best_vec[0] = dx;
-            best_vec[1] = dy;
+            error = SAD_qpel_bounded(current, previous, ox, oy, qx+x, qy+y,
+                                     blk_size, best);
+
+            if(error < best)
+            {
+              best = error;
+              best_vec = integer_vec + MotionVector(x, y);
+            }
           }
         }
+
+        candidates = (maxx-minx+1)*(maxy-miny+1);
       }
 
+      if(block_stats)
+        (*block_stats)[by*blocks_wide + bx].subpixel = candidates;
+
       motion[by*blocks_wide + bx] = best_vec;
     }
   }
@@ -9,20 +9,75 @@
 #define subpixel_h
 
 #include <vector>
+#include <string>
 #include <opencv2/core.hpp>
 
 #include "bmsupport.h"
+#include "blockstats.h"
+#include "motionvector.h"
 
 
+/// How integer vectors are refined to quarter pixels
+enum SubpixelMode
+{
+  SUBPIXEL_FULL,        ///< every quarter pixel offset up to 3/4 pixel, 49 SADs
+  SUBPIXEL_TWO_STAGE,   ///< 8 half pixel neighbours, then 8 quarter pixel
+                        ///< neighbours of the best, 17 SADs
+  SUBPIXEL_PARABOLIC    ///< parabola through the SADs of the integer vector
+                        ///< and its 4 whole pixel neighbours, 5 SADs and no
+                        ///< interpolated ones
+};
+
+/**
+ * Name of a subpixel mode; "full", "twostage" or "parabolic"
+ * @param mode       mode
+ * @return name
+ */
+const char *subpixel_mode_name(SubpixelMode mode);
+
+/**
+ * Find a subpixel mode by name
+ * @param name       name as given by subpixel_mode_name()
+ * @param mode       set to the mode if found
+ * @return true if found
+ */
+bool find_subpixel_mode(const std::string &name, SubpixelMode &mode);
+
 /**
  * Subpixel motion estimation
  * @param current    current frame
  * @param previous   previous frame
  * @param blk_size   block size
- * @param mv         integer motion vectors
+ * @param mv         integer motion vectors, refined to quarter pixels
  */
 void subpixel_search(const cv::Mat &current, const cv::Mat &previous,
-                     int blk_size, std::vector<cv::Vec2f> &mv);
+                     int blk_size, MotionField &mv);
+
+/**
+ * Subpixel motion estimation using precomputed phase planes of the
+ * previous frame; with SUBPIXEL_FULL gives the same vectors as the version
+ * above. The two stage search checks the integer vector and the half pixel
+ * offsets around it, then the quarter pixel offsets around the best of
+ * those. The parabolic fit puts the minimum of a parabola through the
+ * SADs at -1, 0 and +1 pixel on each axis, rounded to a quarter pixel and
+ * at most half a pixel from the integer vector. All modes keep within the
+ * same limits at the edges of the image.
+ * @param current    current frame
+ * @param previous   interpolated previous frame
+ * @param blk_size   block size
+ * @param mv         integer motion vectors, refined to quarter pixels
+ * @param block_stats  if not null, the number of candidates of each block
+ *                     is set in this, which is resized to match mv
+ * @param skip       if not null, static blocks are not refined and keep
+ *                   their zero vector
+ * @param mode       how to refine
+ */
+void subpixel_search(const cv::Mat &current,
+                     const InterpolatedReference &previous,
+                     int blk_size, MotionField &mv,
+                     BlockStatsField *block_stats = nullptr,
+                     const SkipMap *skip = nullptr,
+                     SubpixelMode mode = SUBPIXEL_FULL);
 
 #endif    // subpixel_h
 
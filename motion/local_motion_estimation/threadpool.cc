@@ -0,0 +1,92 @@
+/**
+ * @file   threadpool.cc
+ * @brief  Simple thread pool for running loops in parallel
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#include <algorithm>
+
+#include "threadpool.h"
+
+
+ThreadPool::ThreadPool(int threads)
+  : body_(nullptr), count_(0), next_(0), active_(0), generation_(0),
+    stop_(false)
+{
+  if(threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+  for(int t = 1; t < threads; t++)
+    workers_.emplace_back(&ThreadPool::worker, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_cv_.notify_all();
+
+  for(std::thread &t : workers_) t.join();
+}
+
+// Run loop across threads
+void ThreadPool::parallel_for(int count, const std::function<void(int)> &body)
+{
+  if(workers_.empty() || (count <= 1))
+  {
+    for(int i = 0; i < count; i++) body(i);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    body_   = &body;
+    count_  = count;
+    next_   = 0;
+    active_ = (int)workers_.size();
+    generation_++;
+  }
+  start_cv_.notify_all();
+
+  run_iterations();
+
+  // Wait for workers to finish their last iteration
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [this]{ return(active_ == 0); });
+  body_ = nullptr;
+}
+
+// Worker thread
+void ThreadPool::worker()
+{
+  unsigned int seen = 0;
+
+  while(true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_cv_.wait(lock, [&]{ return(stop_ || (generation_ != seen)); });
+      if(stop_) return;
+      seen = generation_;
+    }
+
+    run_iterations();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      active_--;
+    }
+    done_cv_.notify_one();
+  }
+}
+
+// Take iterations
+void ThreadPool::run_iterations()
+{
+  int i;
+  while((i = next_.fetch_add(1)) < count_)
+    (*body_)(i);
+}
@@ -0,0 +1,82 @@
+/**
+ * @file   threadpool.h
+ * @brief  Simple thread pool for running loops in parallel
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#ifndef threadpool_h
+#define threadpool_h
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+
+/**
+ * ThreadPool
+ * @brief Persistent worker threads that execute the iterations of a loop.
+ *        Iterations are handed out in increasing order, one at a time, so
+ *        an iteration may wait on the progress of an earlier one.
+ */
+class ThreadPool
+{
+public:
+  /**
+   * Start worker threads
+   * @param threads   total number of threads including the calling thread;
+   *                  0 means one per hardware thread
+   */
+  explicit ThreadPool(int threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /**
+   * Run body(i) for i = 0 to count-1 across all threads, including the
+   * calling thread, and wait for all iterations to finish
+   * @param count     number of iterations
+   * @param body      loop body
+   */
+  void parallel_for(int count, const std::function<void(int)> &body);
+
+  /**
+   * As above for a named loop body, which is referred to rather than
+   * copied into the std::function so that no memory is allocated
+   * @param count     number of iterations
+   * @param body      loop body
+   */
+  template<typename Body>
+  void parallel_for(int count, Body &body)
+  {
+    parallel_for(count, std::function<void(int)>(std::ref(body)));
+  }
+
+  /// Total number of threads including the calling thread
+  int size() const { return((int)workers_.size() + 1); }
+
+private:
+  // Worker thread main loop
+  void worker();
+
+  // Take iterations until there are none left
+  void run_iterations();
+
+  std::vector<std::thread> workers_;
+  std::mutex               mutex_;
+  std::condition_variable  start_cv_, done_cv_;
+
+  const std::function<void(int)> *body_;
+  int              count_;
+  std::atomic<int> next_;
+  int              active_;       // Workers still running current loop
+  unsigned int     generation_;   // Incremented for each loop
+  bool             stop_;
+};
+
+#endif    // threadpool_h
+
@@ -0,0 +1,165 @@
+/**
+ * @file   umhexagons.cc
+ * @brief  Block Matching Algorithm: UMHexagonS
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#include "umhexagons.h"
+#include "fullsearch.h"
+#include "bmsupport.h"
+#include "staticblocks.h"
+
+
+// Unsymmetrical cross, horizontal range twice the vertical
+static void cross_search(BlockSearch &search, int range)
+{
+  int cx = search.best_x();
+  int cy = search.best_y();
+
+  for(int d = 2; d <= range; d += 2)
+  {
+    search.check(cx - d, cy);
+    search.check(cx + d, cy);
+  }
+
+  for(int d = 2; d <= range/2; d += 2)
+  {
+    search.check(cx, cy - d);
+    search.check(cx, cy + d);
+  }
+}
+
+// Full search of +/-2 pixels
+static void square_search(BlockSearch &search)
+{
+  int cx = search.best_x();
+  int cy = search.best_y();
+
+  for(int dy = -2; dy <= 2; dy++)
+    for(int dx = -2; dx <= 2; dx++)
+      search.check(cx + dx, cy + dy);
+}
+
+// 16 point hexagons of radius 4, 8, ... range
+static void multi_hexagon_search(BlockSearch &search, int range)
+{
+  static const int hexagon[16][2] = {
+    { 0,  4}, {-2,  3}, {-4,  2}, {-4,  1}, {-4,  0}, {-4, -1}, {-4, -2},
+    {-2, -3}, { 0, -4}, { 2, -3}, { 4, -2}, { 4, -1}, { 4,  0}, { 4,  1},
+    { 4,  2}, { 2,  3} };
+
+  int cx = search.best_x();
+  int cy = search.best_y();
+
+  for(int scale = 1; scale <= range/4; scale++)
+    for(int i = 0; i < 16; i++)
+      search.check(cx + scale*hexagon[i][0], cy + scale*hexagon[i][1]);
+}
+
+// Estimate motion of one block; the left, top and top right blocks must
+// already have been estimated
+static void umhexagons_block(const cv::Mat &current, const cv::Mat &previous,
+                             int bx, int by, int blk_size,
+                             const MotionField *previous_field,
+                             PredictiveWorkspace &workspace, MotionField &mv,
+                             BlockStats *stats)
+{
+  int blocks_wide = current.cols/blk_size;
+  int index = by*blocks_wide + bx;
+
+  BlockSearch search(current, previous, bx*blk_size, by*blk_size, blk_size,
+                     RANGE);
+
+  // 1. Predictors
+
+  search.check(median_predictor(mv, bx, by, blocks_wide));
+  search.check(0, 0);
+
+  if(bx > 0) search.check(mv[index-1]);
+  if(by > 0) {
+    search.check(mv[index-blocks_wide]);
+    if(bx < blocks_wide-1) search.check(mv[index-blocks_wide+1]);
+  }
+
+  if(previous_field) search.check((*previous_field)[index]);
+
+  // Skip steps when the best predictor is about as good as the neighbours
+
+  int predicted = neighbour_sad(workspace.sad, bx, by, blocks_wide);
+  bool near  = (predicted != INT_MAX) &&
+               (search.best_sad() < predicted + predicted/2);
+  bool close = near && (search.best_sad() < predicted + predicted/8);
+
+  if(!near)
+  {
+    // 2. Unsymmetrical cross
+
+    cross_search(search, RANGE);
+
+    // 3. Small full search and uneven multi-hexagon grid
+
+    square_search(search);
+    multi_hexagon_search(search, RANGE);
+  }
+
+  // 4. Extended hexagon and small diamond
+
+  if(!close) hexagon_refine(search);
+  diamond_refine(search);
+
+  mv[index] = search.best();
+  workspace.sad[index] = search.best_sad();
+
+  if(stats)
+    set_block_stats(search, EXIT_SEARCH, close ? PATTERN_SMALL : PATTERN_LARGE,
+                    *stats);
+}
+
+// UMHexagonS
+MotionField umhexagons(const cv::Mat &current, const cv::Mat &previous,
+                       int blk_size, const MotionField *previous_field)
+{
+  PredictiveWorkspace workspace;
+  MotionField mv;
+  umhexagons(current, previous, blk_size, nullptr, previous_field, workspace,
+             mv);
+  return(mv);
+}
+
+// UMHexagonS with workspace; serial if pool is null, otherwise a wavefront
+void umhexagons(const cv::Mat &current, const cv::Mat &previous, int blk_size,
+                ThreadPool *pool, const MotionField *previous_field,
+                PredictiveWorkspace &workspace, MotionField &mv,
+                BlockStatsField *block_stats, const SkipMap *skip)
+{
+  int blocks_wide = current.cols/blk_size;
+  int blocks_high = current.rows/blk_size;
+
+  mv.resize(blocks_wide*blocks_high);
+  workspace.sad.resize(mv.size());
+  if(block_stats) block_stats->resize(mv.size());
+
+  if(previous_field && (previous_field->size() != mv.size()))
+    previous_field = nullptr;
+
+  auto process_block = [&](int bx, int by)
+  {
+    int index = by*blocks_wide + bx;
+
+    if(is_static(skip, index))
+    {
+      static_block(current, previous, bx, by, blk_size, blocks_wide,
+                   workspace.sad, mv,
+                   block_stats ? &(*block_stats)[index] : nullptr);
+      return;
+    }
+
+    umhexagons_block(current, previous, bx, by, blk_size, previous_field,
+                     workspace, mv,
+                     block_stats ? &(*block_stats)[index] : nullptr);
+  };
+
+  run_wavefront(blocks_wide, blocks_high, pool, workspace.wavefront,
+                process_block);
+}
@@ -0,0 +1,73 @@
+/**
+ * @file   umhexagons.h
+ * @brief  Block Matching Algorithm: UMHexagonS
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#ifndef umhexagons_h
+#define umhexagons_h
+
+#include <opencv2/core.hpp>
+
+#include "threadpool.h"
+#include "blocksearch.h"
+#include "motionvector.h"
+
+
+/**
+ * umhexagons
+ * @brief Unsymmetrical-cross Multi-Hexagon-grid Search,
+ *        "Fast Integer Pel and Fractional Pel Motion Estimation for JVT",
+ *        2002, Z. Chen, P. Zhou and Y. He, JVT-F017
+ *        1. The median, zero, left, top, top right and co-located
+ *           predictors are checked.
+ *        2. A cross of +/-RANGE horizontally and +/-RANGE/2 vertically in
+ *           steps of 2 pixels, since motion is mostly horizontal.
+ *        3. A 5x5 full search, then 16 point hexagons of radius 4, 8, ...
+ *           RANGE around the best vector.
+ *        4. Large hexagon then small diamond search until the centre is
+ *           best.
+ *        If after step 1 the best SAD is within 1/8 of the least SAD of the
+ *        neighbouring blocks only the small diamond is run, and if within
+ *        1/2 steps 2 and 3 are skipped; the reference encoder adapts these
+ *        margins to block size and the neighbouring SAD. Slower than EPZS,
+ *        but much less likely to stop in a local minimum. Runs as a
+ *        wavefront with a pool; vectors are the same. Vectors are limited
+ *        to +/-RANGE.
+ * @param current          current image
+ * @param previous         previous image
+ * @param blk_size         block size
+ * @param previous_field   whole pixel vectors of the previous frame with the
+ *                         same block size, or null for spatial predictors
+ *                         only
+ * @return  motion vectors
+ */
+MotionField umhexagons(const cv::Mat &current, const cv::Mat &previous,
+                       int blk_size,
+                       const MotionField *previous_field = nullptr);
+
+/**
+ * umhexagons
+ * @brief As above using a workspace and writing into an existing field, so
+ *        that nothing is allocated from frame to frame
+ * @param current          current image
+ * @param previous         previous image
+ * @param blk_size         block size
+ * @param pool             threads to run the wavefront on, or null to run
+ *                         serially
+ * @param previous_field   vectors of the previous frame, or null
+ * @param workspace        wavefront progress and SADs of each block
+ * @param mv               motion vectors
+ * @param block_stats      if not null, set to the SADs, pattern steps and
+ *                         pattern of each block
+ * @param skip             if not null, static blocks are given a zero vector
+ *                         without a search
+ */
+void umhexagons(const cv::Mat &current, const cv::Mat &previous, int blk_size,
+                ThreadPool *pool, const MotionField *previous_field,
+                PredictiveWorkspace &workspace, MotionField &mv,
+                BlockStatsField *block_stats = nullptr,
+                const SkipMap *skip = nullptr);
+
+#endif    // umhexagons_h
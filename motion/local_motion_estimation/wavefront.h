@@ -0,0 +1,81 @@
+/**
+ * @file   wavefront.h
+ * @brief  Run block estimation as a wavefront across a thread pool
+ * @author Lyndon Hill
+ * @date   2026.10.16
+ */
+
+#ifndef wavefront_h
+#define wavefront_h
+
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+
+#include "threadpool.h"
+
+
+/// Blocks finished in each block row, kept from frame to frame so that it
+/// is only allocated when the number of rows grows
+struct WavefrontProgress
+{
+  std::unique_ptr<std::atomic<int>[]> done;      ///< blocks finished per row
+  int                                 rows = 0;  ///< size of done
+};
+
+
+/**
+ * run_wavefront
+ * @brief Run block(bx, by) for every block of a grid, for algorithms where
+ *        a block depends on the block to its left and the blocks above and
+ *        above right. Serially the blocks are run in raster order. With a
+ *        pool block rows are spread across threads and each row runs two
+ *        blocks behind the row above, so the blocks being processed at any
+ *        time lie on an anti-diagonal wavefront; results are the same.
+ * @param blocks_wide  blocks per row
+ * @param blocks_high  block rows
+ * @param pool         threads to use, or null to run serially
+ * @param progress     wavefront progress
+ * @param block        estimates one block
+ */
+template<typename Block>
+void run_wavefront(int blocks_wide, int blocks_high, ThreadPool *pool,
+                   WavefrontProgress &progress, Block &block)
+{
+  if(!pool)
+  {
+    for(int by = 0; by < blocks_high; by++)
+      for(int bx = 0; bx < blocks_wide; bx++) block(bx, by);
+    return;
+  }
+
+  if(progress.rows < blocks_high)
+  {
+    progress.done.reset(new std::atomic<int>[blocks_high]);
+    progress.rows = blocks_high;
+  }
+
+  std::atomic<int> *done = progress.done.get();
+  for(int by = 0; by < blocks_high; by++) done[by] = 0;
+
+  auto process_row = [&](int by)
+  {
+    for(int bx = 0; bx < blocks_wide; bx++)
+    {
+      if(by > 0)
+      {
+        int needed = std::min(bx+2, blocks_wide);
+        while(done[by-1].load(std::memory_order_acquire) < needed)
+          std::this_thread::yield();
+      }
+
+      block(bx, by);
+      done[by].store(bx+1, std::memory_order_release);
+    }
+  };
+
+  pool->parallel_for(blocks_high, process_row);
+}
+
+#endif    // wavefront_h